@@ -23,59 +23,112 @@
 #include <rlfd/delay/AverageDisplacement.hh>
 #include <rlfd/delay/DelayEmbedding.hh>
 #include <rlfd/delay/GammaTest.hh>
+#include <rlfd/utils/ParallelFor.hh>
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include <Eigen/Core>
 
 namespace rlfd {
 namespace delay {
 
-Eigen::VectorXd AutomatedEmbedding(const Eigen::VectorXd& ts, int max_lag=50, int max_dimension=10, int nn=20)
+/**
+ * Search for the embedding dimension m and lag of a scalar time series.
+ *
+ * For each m, the lag is taken where the slope of the average displacement
+ * falls under 40% of its initial value, and the Gamma test measures how well
+ * the next sample can be predicted from the delay vectors. The search stops
+ * at the first m whose Gamma statistic is worse than the one of m-1, and
+ * returns m-1 and its lag.
+ *
+ * The average displacements of all the dimensions are computed first, in a
+ * single sweep. Candidate dimensions are then tested concurrently, in
+ * increasing order, on delay vectors read in place from ts. The stopping
+ * criterion is checked in order as soon as the candidates are done, after
+ * which the larger dimensions still pending are skipped.
+ *
+ * @param ts The scalar time series
+ * @param max_lag The number of lags of the average displacement
+ * @param max_dimension The largest dimension evaluated
+ * @param nn The number of nearest neighbors of the Gamma test
+ * @param nthreads The number of threads. 0 means one per core.
+ * @return The dimension and the lag
+ */
+Eigen::VectorXd AutomatedEmbedding(const Eigen::VectorXd& ts, int max_lag=50, int max_dimension=10, int nn=20,
+                                   unsigned nthreads=1)
 {
-  Eigen::VectorXd gamma_dimension(max_dimension);
+  std::vector<int> lags(max_dimension + 1, 1);
+  std::vector<Eigen::VectorXd> statistics(max_dimension + 1);
+  std::vector<bool> done(max_dimension + 1, false);
+
+  // The first dimension whose criterion has not been checked, and the one at
+  // which the search stopped
+  int next = 1;
+  std::atomic<int> stop(max_dimension + 1);
+  std::mutex mutex;
+
+  // Statistics of m = 0, compared with those of m = 1
+  statistics[0] = Eigen::VectorXd(2);
+  statistics[0][0] = 0;
+  statistics[0][1] = 1;
 
-  Eigen::VectorXd previous_statistics(2); 
-  previous_statistics[0] = 0;
-  previous_statistics[1] = 1;
+  // Average displacements of every dimension, one per column
+  Eigen::MatrixXd ads;
+  rlfd::delay::AverageDisplacements(ts, max_dimension, max_lag, ads, nthreads);
+
+  rlfd::utils::ParallelFor(max_dimension, nthreads, [&](size_t i) {
+    const int m = i + 1;
+    if (m > stop) {
+      return;
+    }
 
-  int previous_th = 1;
-  for (int m = 1; m <= max_dimension; m++) {
     // Estimate the time lag for m by the average displacement method
-    Eigen::VectorXd ads = rlfd::delay::AverageDisplacement(ts, m, max_lag); 
-    double initial = (ads[2] - ads[0])/2.0;
+    auto ad = ads.col(m-1);
+    double initial = (ad[2] - ad[0])/2.0;
     int lag;
-    for (lag = 2; lag < ads.size() - 1; lag++) {
-      if ((ads[lag+1] - ads[lag-1])/2.0 <= 0.4*initial) {
+    for (lag = 2; lag < ad.size() - 1; lag++) {
+      if ((ad[lag+1] - ad[lag-1])/2.0 <= 0.4*initial) {
         break;
       }
     }
 
     // Estimate the maximum error that could be achieved by fitting the best smooth
-    // non-linear model of this dimension and the lag found above. 
-    Eigen::MatrixXd ts_embedded;
-    rlfd::delay::DelayEmbedding::Embed(ts, m, lag, ts_embedded);
+    // non-linear model of this dimension and the lag found above.
+    auto ts_embedded = rlfd::delay::DelayEmbedding::EmbedView(ts, m, lag);
 
     // Create the output vector for the gamma statistics
     int M = ts.size() - m*lag;
-    Eigen::VectorXd next_points(M);
-    for (int i = 0; i < M; i++) {
-      next_points[i] = ts[i + m*lag];
+    Eigen::VectorXd next_points = ts.segment(m*lag, M);
+    Eigen::VectorXd result = rlfd::delay::GammaTest(ts_embedded.topRows(M), next_points, nn);
+
+    // Check the criterion of every dimension done so far, in order
+    std::lock_guard<std::mutex> lock(mutex);
+    lags[m] = lag;
+    statistics[m] = result;
+    done[m] = true;
+    for (; next <= max_dimension && next < stop && done[next]; next++) {
+      const Eigen::VectorXd& current = statistics[next];
+      const Eigen::VectorXd& previous = statistics[next-1];
+      std::cout << "statistics m " << next << " " << lags[next] << " " << current << std::endl;
+
+      // Stop if local minimum is reached
+      if (current[0] > 0.0 && current[1] < 0.20 && std::abs(previous[1]) < std::abs(current[1])) {
+        stop = next;
+      }
     }
-    auto statistics = rlfd::delay::GammaTest(ts_embedded.topRows(M), next_points, nn);
-    std::cout << "statistics m " << m << " " << lag << " " << statistics << std::endl;
-
-    // Stop if local minimum is reached
-    if (statistics[0] > 0.0 && statistics[1] < 0.20 && std::abs(previous_statistics[1]) < std::abs(statistics[1])) {
-      Eigen::VectorXd parameters(2);
-      parameters[0] = m-1;
-      parameters[1] = previous_th;
-      return parameters;
-    }  
-    previous_statistics = statistics;
-    previous_th = lag;
-  }
+  });
 
-  // Should not be reached if proper parameters are found
   Eigen::VectorXd parameters(2);
-  parameters[0] = 1;
-  parameters[1] = 1;
+  if (stop <= max_dimension) {
+    parameters[0] = stop - 1;
+    parameters[1] = lags[stop - 1];
+  } else {
+    // Should not be reached if proper parameters are found
+    parameters[0] = 1;
+    parameters[1] = 1;
+  }
   return parameters;
 }
 
@@ -20,6 +20,12 @@
 #ifndef __AVERAGE_DISPLACEMENT_HH__
 #define __AVERAGE_DISPLACEMENT_HH__
 
+#include <rlfd/utils/FFTPlans.hh>
+#include <rlfd/utils/ParallelFor.hh>
+
+#include <cmath>
+#include <fftw3.h>
+#include <algorithm>
 #include <Eigen/Core>
 
 namespace rlfd {
@@ -32,6 +38,9 @@ namespace delay {
  * as a geometry-based framework for choosing proper delay times," Physica D:
  * Nonlinear Phenomena, vol. 73, no. 1–2, pp. 82–98, May 1994.
  *
+ * The displacements of all the delay vectors are accumulated at once for
+ * each lag.
+ *
  * @param ts The input time series to analyze
  * @param m The embedding dimension
  * @param nlags The number of average displacement points to compute
@@ -41,20 +50,122 @@ Eigen::VectorXd AverageDisplacement(const Eigen::VectorXd& ts, int m, int nlags)
 {
   Eigen::VectorXd ad(nlags);
 
+  // Number of delay vectors, the same for every lag
+  const int n = std::max((int) ts.size() - nlags*(m-1), 0);
+  Eigen::ArrayXd sum_squares(n);
+
   // Compute for a range of lags
   for (int k = 0; k < nlags; k++) {
-    double average_displacement = 0.0;
-    for (int i = 0; i < (ts.size() - nlags*(m-1)); i++)
-    {
-      double sum_squares = 0.0;
-      for (int j = 1; j <= (m-1); j++) {
-        sum_squares += std::pow(ts[i + j*k] - ts[i], 2);
-      }
-      average_displacement += std::sqrt(sum_squares);
+    sum_squares.setZero();
+    for (int j = 1; j <= (m-1); j++) {
+      sum_squares += (ts.segment(j*k, n) - ts.head(n)).array().square();
+    }
+    ad[k] = sum_squares.sqrt().sum()/((double) ts.size());
+  }
+
+  return ad;
+}
+
+/**
+ * Compute the S_m statistic of AverageDisplacement for every embedding
+ * dimension up to max_dimension in one sweep. The squared displacements of
+ * dimension m+1 are those of dimension m plus one coordinate, so that each
+ * lag costs as much as the largest dimension alone.
+ *
+ * @param ts The input time series to analyze
+ * @param max_dimension The largest embedding dimension
+ * @param nlags The number of average displacement points to compute
+ * @param out nlags x max_dimension matrix holding the statistics of dimension
+ * m in column m-1
+ * @param nthreads The number of threads sharing the lags. 0 means one per core.
+ */
+void AverageDisplacements(const Eigen::VectorXd& ts, int max_dimension, int nlags, Eigen::MatrixXd& out,
+                          unsigned nthreads=1)
+{
+  out.setZero(nlags, max_dimension);
+
+  rlfd::utils::ParallelFor(nlags, nthreads, [&](size_t k) {
+    // Dimension 2 has the most delay vectors, and the following ones a prefix
+    // of them
+    Eigen::ArrayXd sum_squares = Eigen::ArrayXd::Zero(std::max((int) ts.size() - nlags, 0));
+    for (int m = 2; m <= max_dimension; m++) {
+      const int n = std::max((int) ts.size() - nlags*(m-1), 0);
+      sum_squares.head(n) += (ts.segment((m-1)*k, n) - ts.head(n)).array().square();
+      out(k, m-1) = sum_squares.head(n).sqrt().sum()/((double) ts.size());
+    }
+  });
+}
+
+/**
+ * Bound the S_m statistic of AverageDisplacement from above, in
+ * O(n log n) for all the lags.
+ *
+ * The norms of the displacements are replaced by their root mean square, which
+ * is no smaller than their mean. The bound is tight when the displacements
+ * all have about the same norm, and overestimates S_m by (M/N) var/(rms + mean)
+ * otherwise, where M delay vectors out of N samples have norms of variance
+ * var. The sum of the squared norms only involves sums of squares, taken from
+ * a cumulative sum, and the products ts[i]ts[i+j*k] summed over the delay
+ * vectors, which are a cross-correlation computed with the FFT plans of
+ * rlfd::utils::FFTPlans.
+ *
+ * @param ts The input time series to analyze
+ * @param m The embedding dimension
+ * @param nlags The number of average displacement points to compute
+ * @return A vector of length nlags holding the upper bound of each S_m statistic
+ */
+Eigen::VectorXd AverageDisplacementBound(const Eigen::VectorXd& ts, int m, int nlags)
+{
+  const int N = ts.size();
+  const int n = std::max(N - nlags*(m-1), 0);
+  Eigen::VectorXd ad = Eigen::VectorXd::Zero(nlags);
+  if (n == 0 || m < 2) {
+    return ad;
+  }
+
+  // The displacements do not depend on the mean, which would only cost
+  // precision to the differences below
+  Eigen::VectorXd centered = ts.array() - ts.mean();
+
+  // Cumulative sums of squares
+  Eigen::VectorXd squares(N + 1);
+  squares[0] = 0.0;
+  for (int i = 0; i < N; i++) {
+    squares[i+1] = squares[i] + centered[i]*centered[i];
+  }
+
+  // Cross-correlation of the first n samples with the whole series. The
+  // largest lag (m-1)*(nlags-1) plus n stays below N, so the circular
+  // correlation of length P >= N does not wrap around.
+  const int P = std::exp2(std::ceil(std::log2(N)));
+  const int nf = P/2 + 1;
+  double* scratch = fftw_alloc_real(2*P);
+  fftw_complex* spectra = fftw_alloc_complex(2*nf);
+  Eigen::Map<Eigen::MatrixXd> padded(scratch, P, 2);
+  padded.setZero();
+  padded.col(0).head(n) = centered.head(n);
+  padded.col(1).head(N) = centered;
+
+  fftw_execute_dft_r2c(rlfd::utils::FFTPlans::Instance().Get(P, 2).forward, scratch, spectra);
+  for (int f = 0; f < nf; f++) {
+    double re = spectra[f][0]*spectra[nf+f][0] + spectra[f][1]*spectra[nf+f][1];
+    double im = spectra[f][0]*spectra[nf+f][1] - spectra[f][1]*spectra[nf+f][0];
+    spectra[f][0] = re;
+    spectra[f][1] = im;
+  }
+  fftw_execute_dft_c2r(rlfd::utils::FFTPlans::Instance().Get(P).backward, spectra, scratch);
+
+  // The transforms are unnormalized
+  for (int k = 0; k < nlags; k++) {
+    double sum_squares = 0.0;
+    for (int j = 1; j <= (m-1); j++) {
+      sum_squares += squares[j*k + n] - squares[j*k] + squares[n] - 2.0*scratch[j*k]/P;
     }
-    ad[k] = average_displacement/((double) ts.size());
+    ad[k] = std::sqrt(std::max(sum_squares, 0.0)*n)/N;
   }
 
+  fftw_free(scratch);
+  fftw_free(spectra);
   return ad;
 }
 
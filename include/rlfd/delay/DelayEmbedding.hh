@@ -20,10 +20,16 @@
 #ifndef __DELAY_EMBEDDING_HH__
 #define __DELAY_EMBEDDING_HH__
 
-#include <flann/flann.hpp>
+#include <rlfd/utils/KdTree.hh>
+#include <rlfd/utils/IndexCache.hh>
 #include <rlfd/utils/ImportExport.hh>
 
 #include <memory>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
 #include <Eigen/Core>
 
 namespace rlfd {
@@ -35,6 +41,12 @@ class DelayEmbedding
   // Row-major is important for compability with flann
   typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> EigenMatrixXdRowMajor;
 
+  /**
+   * Delay vectors read in place from the scalar time series: column j starts
+   * at ts[j*lag], so that row i is (ts[i], ts[i+lag], ..., ts[i+(m-1)*lag]).
+   */
+  typedef Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<>> View;
+
   /**
    * Load the Kd-Tree index from a file
    * @param filename The path to the index file
@@ -43,11 +55,7 @@ class DelayEmbedding
    */
   void LoadIndex(const std::string& filename)
   {
-    data = std::unique_ptr<flann::Matrix<double>>(new flann::Matrix<double>
-                                                  (const_cast<double*>(embeddedTs.data()),
-                                                  embeddedTs.rows(), embeddedTs.cols()));
-    index = std::unique_ptr<flann::Index<flann::L2<double>>>(new flann::Index<flann::L2<double>>
-                                                             (*data, flann::SavedIndexParams(filename)));
+    index = std::unique_ptr<rlfd::utils::KdTree>(new rlfd::utils::KdTree(embeddedTs, filename));
   }
 
   /**
@@ -66,20 +74,22 @@ class DelayEmbedding
    */
   void BuildIndex()
   {
+    index = std::unique_ptr<rlfd::utils::KdTree>(new rlfd::utils::KdTree(embeddedTs));
+  }
 
-    data = std::unique_ptr<flann::Matrix<double>>(new flann::Matrix<double>
-                                                  (const_cast<double*>(embeddedTs.data()),
-                                                  embeddedTs.rows(), embeddedTs.cols()));
-
-    index = std::unique_ptr<flann::Index<flann::L2<double>>>(new flann::Index<flann::L2<double>>
-                                                             (*data, flann::KDTreeSingleIndexParams()));
-    index->buildIndex();
+  /**
+   * Load the kd-tree index of the points contained in the internal matrix from
+   * a cache, or build it and save it there if missing or stale.
+   */
+  void BuildIndex(rlfd::utils::IndexCache& cache)
+  {
+    index = cache.Get(embeddedTs);
   }
 
   /**
    * @return A non-const reference to the kd-tree index
    */
-  flann::Index<flann::L2<double>>& GetIndex(void)
+  rlfd::utils::KdTree& GetIndex(void)
   {
     return (*index);
   }
@@ -92,6 +102,19 @@ class DelayEmbedding
     return embeddedTs;
   }
 
+  /**
+   * Embed a scalar time series without copying it
+   * @param ts The measured time series, which must outlive the view
+   * @param m The embedding dimension
+   * @param lag The lag parameter
+   * @return M x m view where M = N-(m-1)*lag
+   */
+  static View EmbedView(const Eigen::VectorXd& ts, int m, int lag)
+  {
+    int M = std::max((int) ts.size() - (m-1)*lag, 0);
+    return View(ts.data(), M, m, Eigen::OuterStride<>(lag));
+  }
+
   /**
    * Embbed a sclar time series
    * @param ts The measured time series
@@ -112,15 +135,98 @@ class DelayEmbedding
     }
   }
 
+  /**
+   * Embed a multichannel time series into concatenated delay vectors.
+   *
+   * Channel c contributes m[c] coordinates spaced by lag[c] samples, and the
+   * delay vectors of all the channels end on the same sample: row i holds
+   * ts(i + s + j*lag[c], c) for j = 0..m[c]-1, where s is the difference
+   * between the longest span (m-1)*lag and the span of channel c. The output
+   * is filled one column at a time, each a contiguous slice of a channel.
+   * @param ts One channel per column
+   * @param m The embedding dimension of each channel
+   * @param lag The lag of each channel
+   * @param out M x sum(m) matrix where M = N-max((m-1)*lag)
+   */
+  template<typename EigenMatrixType=Eigen::MatrixXd>
+  static void Embed(const Eigen::MatrixXd& ts, const Eigen::VectorXi& m, const Eigen::VectorXi& lag,
+                    EigenMatrixType& out) throw(std::runtime_error)
+  {
+    if (m.size() != ts.cols() || lag.size() != ts.cols()) {
+      throw std::runtime_error("Expected an embedding dimension and a lag per channel");
+    }
+
+    const int span = Span(m, lag);
+    const int M = std::max((int) ts.rows() - span, 0);
+    out.resize(M, m.sum());
+
+    int column = 0;
+    for (int c = 0; c < ts.cols(); c++) {
+      int offset = span - (m[c]-1)*lag[c];
+      for (int j = 0; j < m[c]; j++) {
+        out.col(column++) = ts.col(c).segment(offset + j*lag[c], M);
+      }
+    }
+  }
+
+  /**
+   * @return The number of samples between the first and last coordinates of
+   * the multichannel delay vectors
+   */
+  static int Span(const Eigen::VectorXi& m, const Eigen::VectorXi& lag)
+  {
+    int span = 0;
+    for (int c = 0; c < m.size(); c++) {
+      span = std::max(span, (m[c]-1)*lag[c]);
+    }
+    return span;
+  }
+
  protected:
   EigenMatrixXdRowMajor embeddedTs;
 
   // Maintain the embedded points in a KD-Tree for fast retrieval
-  std::unique_ptr<flann::Matrix<double>> data;
-  std::unique_ptr<flann::Index<flann::L2<double>>> index;
+  std::unique_ptr<rlfd::utils::KdTree> index;
 
 };
 
+/**
+ * Parse embedding parameters given either as a single value shared by all the
+ * channels, or as one comma-separated value per channel.
+ * @param values For instance "3" or "3,2,4"
+ * @param channels The number of channels
+ * @throw std::runtime_error If a value is not a positive integer, or if there
+ * are neither one value nor one per channel
+ */
+Eigen::VectorXi ChannelParameters(const std::string& values, int channels) throw(std::runtime_error)
+{
+  std::vector<int> parsed;
+  std::stringstream stream(values);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    int parameter;
+    size_t end;
+    try {
+      parameter = std::stoi(value, &end);
+    } catch (const std::logic_error& e) {
+      // std::invalid_argument or std::out_of_range
+      throw std::runtime_error("Invalid value " + value + " in " + values);
+    }
+    if (end != value.size() || parameter <= 0) {
+      throw std::runtime_error("Expected a positive integer instead of " + value + " in " + values);
+    }
+    parsed.push_back(parameter);
+  }
+
+  if (parsed.size() == 1) {
+    return Eigen::VectorXi::Constant(channels, parsed[0]);
+  }
+  if ((int) parsed.size() != channels) {
+    throw std::runtime_error("Expected one value or " + std::to_string(channels) + " in " + values);
+  }
+  return Eigen::Map<Eigen::VectorXi>(parsed.data(), parsed.size());
+}
+
 } // namespace delay
 } // namespace rlfd
 #endif // __DELAY_EMBEDDING_HH__
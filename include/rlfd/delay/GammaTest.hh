@@ -20,69 +20,75 @@
 #ifndef __GAMMA_TEST_H__
 #define __GAMMA_TEST_H__
 
+#include <rlfd/utils/KdTree.hh>
+
 #include <Eigen/Dense>
-#include <flann/flann.hpp>
 
 namespace rlfd {
 namespace delay {
 
+typedef rlfd::utils::KdTree::Indices NeighborIndices;
+typedef rlfd::utils::KdTree::Distances NeighborDistances;
+
 /**
- * Compute the Gamma Test on the set of points
- * @param in The input x time series. 
- * @param out The output y time series. 
- * @return A vector where the second component is the gamma statistic while the first
- * is the slope of the regression line for the pairs coordinates (gamma, delta) and is a 
- * a good indicator of the complexity	of the surface defined by f. 
+ * Fit the Gamma test regression line from the nearest neighbors of every input
+ * point.
+ * @param indices The nn+1 nearest neighbors of each point, itself first
+ * @param dists The corresponding squared distances
+ * @param out The output y time series.
+ * @param nn The number of nearest neighbors, besides the point itself
+ * @return The slope and the intercept, as returned by GammaTest
  */
-Eigen::VectorXd GammaTest(const Eigen::MatrixXd& in, const Eigen::VectorXd& out, int nn) 
+Eigen::VectorXd GammaRegression(const Eigen::Ref<const NeighborIndices>& indices,
+                                const Eigen::Ref<const NeighborDistances>& dists,
+                                const Eigen::Ref<const Eigen::VectorXd>& out, int nn)
 {
-  // Type conversions. No memory duplication. 
-  // @fixme seems to be no way to avoid const_cast unless the data is duplicated 
-  //flann::Matrix<double> input(const_cast<double*>(in.data()), in.rows(), in.cols());
-  flann::Matrix<double> input(new double[in.rows()*in.cols()], in.rows(), in.cols());
-  for (int i = 0; i  < in.rows(); i++) {
-    for (int j = 0; j < in.cols(); j++) {
-      input[i][j] = in(i, j);
-    }
-  }
-
-  flann::Index<flann::L2<double> > index(input, flann::KDTreeSingleIndexParams());
-  index.buildIndex();
-
-  // Compute the k-nearest neighbors for every input points
-  flann::Matrix<int> indices(new int[input.rows*(nn+1)], input.rows, (nn+1));
-  flann::Matrix<double> dists(new double[input.rows*(nn+1)], input.rows, (nn+1));
-  index.knnSearch(input, indices, dists, (nn+1), flann::SearchParams(128));
-
   // Compute delta and gamma for a range of k
   Eigen::MatrixXd deltas(nn, 2);
   Eigen::VectorXd gammas(nn);
   for (int p = 1; p < (nn+1); p++) {
     double average_input_dist = 0.0;
     double average_output_dist = 0.0;
-    for (int i = 0; i < in.rows(); i++) {
-      average_input_dist += dists[i][p];
-      int kthnn = indices[i][p];
+    for (int i = 0; i < indices.rows(); i++) {
+      average_input_dist += dists(i, p);
+      int kthnn = indices(i, p);
       average_output_dist += std::pow(out[kthnn] - out[i], 2);
     }
-    average_input_dist = average_input_dist/((double) in.rows());
-    average_output_dist = average_output_dist/(2.0*in.rows());
+    average_input_dist = average_input_dist/((double) indices.rows());
+    average_output_dist = average_output_dist/(2.0*indices.rows());
 
     deltas(p-1, 0) = average_input_dist;
     deltas(p-1, 1) = 1;
     gammas[p-1] = average_output_dist;
   }
 
-  delete[] input.ptr();
-  delete[] indices.ptr();
-  delete[] dists.ptr();
-                
   // Compute the least square fit to the pairs deltas, gammas and find intercept. 
   // The intercept of the regression line converges 
   // in probability to var(r) as M goes to infinity.
   return deltas.colPivHouseholderQr().solve(gammas);
 }
 
+/**
+ * Compute the Gamma Test on the set of points
+ * @param in The input x time series. 
+ * @param out The output y time series. 
+ * @return A vector where the second component is the gamma statistic while the first
+ * is the slope of the regression line for the pairs coordinates (gamma, delta) and is a 
+ * a good indicator of the complexity	of the surface defined by f. 
+ */
+Eigen::VectorXd GammaTest(const Eigen::Ref<const Eigen::MatrixXd>& in, const Eigen::VectorXd& out, int nn)
+{
+  // The points are only copied when their coordinates are not contiguous
+  rlfd::utils::KdTree index(in);
+
+  // Compute the k-nearest neighbors for every input points
+  NeighborIndices neighbors;
+  NeighborDistances neighborDists;
+  index.Knn(nn+1, neighbors, neighborDists);
+
+  return GammaRegression(neighbors, neighborDists, out, nn);
+}
+
 } // namespace delay
 } // namespace rlfd
 
@@ -20,7 +20,8 @@
 #ifndef __GEOMETRICTEMPLATEMATCHING_HH__
 #define __GEOMETRICTEMPLATEMATCHING_HH__
 
-#include <flann/flann.hpp>
+#include <rlfd/delay/DelayEmbedding.hh>
+#include <rlfd/utils/KdTree.hh>
 
 namespace rlfd {
 namespace delay {
@@ -33,30 +34,24 @@ namespace delay {
  * with S. Mannor and D. Precup, July 2010.
  *
  * @param index A pre-built index for the model
- * @param testEmb The embedded test time series
+ * @param testEmb The embedded test time series, possibly a
+ * DelayEmbedding::View
  * @param scores Output vector into which the scores are written.
  */
-void GeometricTemplateMatching(DelayEmbedding& model, const Eigen::MatrixXd& testEmb, Eigen::VectorXd& outscores, int seglength=32, int nn=4)
+void GeometricTemplateMatching(DelayEmbedding& model, const Eigen::Ref<const Eigen::MatrixXd>& testEmb, Eigen::VectorXd& outscores, int seglength=32, int nn=4)
 {
   int M = testEmb.rows();
 
   // Score at each i
-  Eigen::VectorXd r(M - seglength);
+  Eigen::VectorXd r = Eigen::VectorXd::Zero(M - seglength);
 
   // Pre-compute the nearest neighbors in the base model for each vector
   // of the test sequence.
-  flann::Matrix<int> indices(new int[testEmb.size()*nn], testEmb.size(), nn);
-  flann::Matrix<double> dists(new double[testEmb.size()*nn], testEmb.size(), nn);
-
-  // Would need to have testEmb in row-major in order to avoid copying
-  flann::Matrix<double> query(new double[testEmb.rows()*testEmb.cols()], testEmb.rows(), testEmb.cols());
-  for (int i = 0; i < testEmb.rows(); i++) {
-    for (int j = 0; j < testEmb.cols(); j++) {
-      query[i][j] = testEmb(i, j);
-    }
-  }
-  model.GetIndex().knnSearch(query, indices, dists, nn, flann::SearchParams(128));
-  auto modelMat = model.GetMatrix();
+  // The test vectors are only copied when their coordinates are not contiguous
+  rlfd::utils::KdTree::Indices indices;
+  rlfd::utils::KdTree::Distances dists;
+  model.GetIndex().Knn(testEmb, nn, indices, dists);
+  const auto& modelMat = model.GetMatrix();
 
   for (int i = 0; i < (M - seglength); i++) {
     for (int j = i; j < (i + seglength - 1); j++) {
@@ -66,7 +61,7 @@ void GeometricTemplateMatching(DelayEmbedding& model, const Eigen::MatrixXd& tes
 
       int nn_found = 0;
       for (int k = 0; k < nn; k++) {
-        int nn_idx = indices[j][k];
+        int nn_idx = indices(j, k);
         if (nn_idx == modelMat.rows()-1) {
           continue;
         }
@@ -74,8 +69,8 @@ void GeometricTemplateMatching(DelayEmbedding& model, const Eigen::MatrixXd& tes
         Usuccessor.row(nn_found) = modelMat.row(nn_idx+1);
         nn_found += 1;
       }
-      U.resize(nn_found, modelMat.cols());
-      Usuccessor.resize(nn_found, modelMat.cols());
+      U.conservativeResize(nn_found, modelMat.cols());
+      Usuccessor.conservativeResize(nn_found, modelMat.cols());
 
       // Compute the mean vector from v_j to v_{j+1}
       Eigen::VectorXd nnAvg = U.colwise().mean();
@@ -20,8 +20,7 @@
 #ifndef __INCREASING_EMBEDDING_HH__
 #define __INCREASING_EMBEDDING_HH__
 
-#include <rlfd/delay/GammaTest.hh>
-#include <rlfd/delay/DelayEmbedding.hh>
+#include <rlfd/delay/IncrementalGammaTest.hh>
 
 #include <Eigen/Core>
 
@@ -31,30 +30,26 @@ namespace rlfd {
 namespace delay {
 
 /**
+ * The Gamma test runs incrementally over the dimensions, see
+ * IncrementalGammaTest.
  * @param The input scalar time series
  * @param The lag parameter (found by some other method such as the average
  * displacement)
  * @param The maximum embedding dimension up to which to compute the gamma
  * statistics.
+ * @throw std::runtime_error If the series is too short for the neighbors of
+ * the embedding of dimension max_dimension
  */
 Eigen::VectorXd IncreasingEmbedding(const Eigen::VectorXd& ts, int lag, int max_dimension, int nn=20)
 {
   Eigen::VectorXd gamma_dimension(max_dimension);
 
+  // Input time series for the gamma test is the m-dimension embedding, and
+  // the output is defined as the next point after the last component of the
+  // embedding vectors.
+  rlfd::delay::IncrementalGammaTest gamma(ts, lag, nn);
   for (int m = 1; m <= max_dimension; m++) {
-    // Input time series for the gamma test is the m-dimension embedding
-    Eigen::MatrixXd ts_embedded;
-    rlfd::delay::DelayEmbedding::Embed(ts, m, lag, ts_embedded);
-
-    // Output is defined as the next point after the last component of the
-    // previous embedding vector.
-    int M = ts.size() - m*lag;
-    Eigen::VectorXd next_points(M);
-    for (int i = 0; i < M; i++) {
-      next_points[i] = ts[i + m*lag];
-    }
-
-    auto slope_intercept = rlfd::delay::GammaTest(ts_embedded.topRows(M), next_points, nn);
+    auto slope_intercept = gamma.Next();
     gamma_dimension[m-1] = std::abs(slope_intercept[1]);
   }
 
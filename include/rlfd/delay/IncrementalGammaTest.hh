@@ -0,0 +1,196 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __INCREMENTAL_GAMMA_TEST_HH__
+#define __INCREMENTAL_GAMMA_TEST_HH__
+
+#include <rlfd/delay/GammaTest.hh>
+#include <rlfd/delay/DelayEmbedding.hh>
+#include <rlfd/utils/KdTree.hh>
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <Eigen/Core>
+
+namespace rlfd {
+namespace delay {
+
+/**
+ * Gamma test of the delay vectors of a scalar time series for the embedding
+ * dimensions 1, 2, ... in turn, each predicting the sample that follows the
+ * last coordinate of the delay vectors.
+ *
+ * The delay vectors of dimension m+1 are those of dimension m with one more
+ * coordinate, so that squared distances only grow with m, by the squared
+ * difference of the new coordinate. Each point keeps K candidate neighbors
+ * across dimensions, along with a lower bound on the distance of all the other
+ * points: the distance of its K-th nearest neighbor when it was last searched.
+ * At the next dimension, the candidates are extended by the new coordinate
+ * and ranked again. They hold the exact nn+1 nearest neighbors as long as the
+ * farthest of these does not exceed the bound, and only the points where it
+ * does are searched again, in a kd-tree built on demand.
+ */
+class IncrementalGammaTest
+{
+ public:
+  /**
+   * @param ts The scalar time series
+   * @param lag The lag parameter
+   * @param nn The number of nearest neighbors
+   * @param candidates The number of candidate neighbors kept for each point,
+   * at least nn+1. 0 means 4(nn+1).
+   */
+  IncrementalGammaTest(const Eigen::VectorXd& ts, int lag = 1, int nn = 20, int candidates = 0) :
+      ts_(ts), lag_(lag), nn_(nn), K_(candidates > 0 ? std::max(candidates, nn+1) : 4*(nn+1)),
+      m_(0), searched_(0) {};
+
+  /**
+   * @return The embedding dimension of the last statistics
+   */
+  int GetDimension() { return m_; }
+
+  /**
+   * @return The number of points whose neighbors had to be searched for the
+   * last statistics
+   */
+  int GetSearched() { return searched_; }
+
+  /**
+   * Move on to the next embedding dimension.
+   * @return The slope and the intercept of the regression line, as returned
+   * by GammaTest
+   */
+  Eigen::VectorXd Next() throw(std::runtime_error)
+  {
+    m_++;
+    const int M = ts_.size() - m_*lag_;
+    if (M <= nn_) {
+      throw std::runtime_error("The time series is too short for embedding dimension " + std::to_string(m_));
+    }
+
+    std::vector<int> stale;
+    if (m_ == 1) {
+      candidates_.resize(M, std::min(K_, M));
+      distances_.resize(M, std::min(K_, M));
+      counts_.setZero(M);
+      bounds_.setZero(M);
+      for (int i = 0; i < M; i++) {
+        stale.push_back(i);
+      }
+    } else {
+      Update(M, stale);
+    }
+    Search(M, stale);
+    searched_ = stale.size();
+
+    return GammaRegression(candidates_.topLeftCorner(M, nn_+1), distances_.topLeftCorner(M, nn_+1),
+                           ts_.segment(m_*lag_, M), nn_);
+  }
+
+ private:
+  /**
+   * Extend the distances to the candidates of the first M points by the
+   * coordinate of dimension m, and rank them again.
+   * @param stale Receives the points whose nearest neighbors are not certain
+   */
+  void Update(int M, std::vector<int>& stale)
+  {
+    const int offset = (m_-1)*lag_;
+    std::vector<std::pair<double, int>> ranked(candidates_.cols());
+
+    for (int i = 0; i < M; i++) {
+      // The delay vectors past M have no output at this dimension
+      int count = 0;
+      for (int k = 0; k < counts_[i]; k++) {
+        int p = candidates_(i, k);
+        if (p < M) {
+          double difference = ts_[i + offset] - ts_[p + offset];
+          ranked[count++] = std::make_pair(distances_(i, k) + difference*difference, p);
+        }
+      }
+      std::sort(ranked.begin(), ranked.begin() + count);
+
+      for (int k = 0; k < count; k++) {
+        distances_(i, k) = ranked[k].first;
+        candidates_(i, k) = ranked[k].second;
+      }
+      counts_[i] = count;
+
+      if (count <= nn_ || distances_(i, nn_) > bounds_[i]) {
+        stale.push_back(i);
+      }
+    }
+  }
+
+  /**
+   * Search the candidates of the stale points among the first M delay vectors
+   * of dimension m
+   */
+  void Search(int M, const std::vector<int>& stale)
+  {
+    if (stale.empty()) {
+      return;
+    }
+
+    auto points = DelayEmbedding::EmbedView(ts_, m_, lag_);
+    DelayEmbedding::EigenMatrixXdRowMajor queries(stale.size(), m_);
+    for (size_t q = 0; q < stale.size(); q++) {
+      queries.row(q) = points.row(stale[q]);
+    }
+
+    rlfd::utils::KdTree index(points.topRows(M));
+
+    const int K = std::min<int>(candidates_.cols(), M);
+    NeighborIndices neighbors;
+    NeighborDistances neighborDists;
+    index.Knn(queries, K, neighbors, neighborDists);
+
+    for (size_t q = 0; q < stale.size(); q++) {
+      int i = stale[q];
+      candidates_.row(i).head(K) = neighbors.row(q);
+      distances_.row(i).head(K) = neighborDists.row(q);
+      counts_[i] = K;
+
+      // Every other point is at least as far as the last candidate
+      bounds_[i] = K < M ? neighborDists(q, K-1) : std::numeric_limits<double>::infinity();
+    }
+  }
+
+  Eigen::VectorXd ts_;
+  int lag_;
+  int nn_;
+  int K_;
+  int m_;
+  int searched_;
+
+  // Candidate neighbors of each point, ranked by their squared distances
+  NeighborIndices candidates_;
+  NeighborDistances distances_;
+  Eigen::VectorXi counts_;
+  Eigen::VectorXd bounds_;
+};
+
+} // namespace delay
+} // namespace rlfd
+
+#endif // __INCREMENTAL_GAMMA_TEST_HH__
@@ -49,7 +49,7 @@ namespace delay {
  */
 Eigen::VectorXd SquaredAverageDisplacement(const Eigen::VectorXd& ts, int m, int nlags)
 {
-  nlags = std::min(nlags, ts.size()-(m-1));
+  nlags = std::min(nlags, (int) ts.size()-(m-1));
 
   // Autocorrelation coefficients
   Eigen::VectorXd acf;
@@ -0,0 +1,98 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __STREAMING_EMBEDDING_HH__
+#define __STREAMING_EMBEDDING_HH__
+
+#include <rlfd/delay/DelayEmbedding.hh>
+
+#include <Eigen/Core>
+
+namespace rlfd {
+namespace delay {
+
+/**
+ * Multichannel delay embedding of a time series received one sample at a
+ * time. The delay vectors are the rows DelayEmbedding::Embed would produce,
+ * each available as soon as its last sample arrives.
+ *
+ * Only the last span+1 samples of every channel are kept, in a ring buffer.
+ */
+class StreamingEmbedding
+{
+ public:
+  /**
+   * @param m The embedding dimension of each channel
+   * @param lag The lag of each channel
+   */
+  StreamingEmbedding(const Eigen::VectorXi& m, const Eigen::VectorXi& lag) :
+      m_(m), lag_(lag), span_(DelayEmbedding::Span(m, lag)),
+      history_(span_ + 1, m.size()), vector_(m.sum()), head_(0), samples_(0) {};
+
+  /**
+   * @return The number of coordinates of the delay vectors
+   */
+  int GetDimension() const { return vector_.size(); }
+
+  /**
+   * Add the next sample of every channel.
+   * @param x One value per channel
+   * @return true if a new delay vector, ending on x, is available from
+   * GetVector
+   */
+  template<typename Derived>
+  bool AddObservation(const Eigen::MatrixBase<Derived>& x)
+  {
+    history_.row(head_) = x.transpose();
+    head_ = (head_ + 1) % history_.rows();
+    if (++samples_ <= span_) {
+      return false;
+    }
+
+    // The oldest sample kept is now at head_
+    int k = 0;
+    for (int c = 0; c < m_.size(); c++) {
+      int offset = head_ + span_ - (m_[c]-1)*lag_[c];
+      for (int j = 0; j < m_[c]; j++) {
+        vector_[k++] = history_((offset + j*lag_[c]) % history_.rows(), c);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @return The latest delay vector
+   */
+  const Eigen::VectorXd& GetVector() const { return vector_; }
+
+ private:
+  Eigen::VectorXi m_;
+  Eigen::VectorXi lag_;
+  int span_;
+
+  // The last span+1 samples, one channel per column
+  Eigen::MatrixXd history_;
+  Eigen::VectorXd vector_;
+  int head_;
+  int samples_;
+};
+
+} // namespace delay
+} // namespace rlfd
+#endif // __STREAMING_EMBEDDING_HH__
@@ -22,12 +22,67 @@
 
 #include <rlfd/Model.hh>
 #include <rlfd/delay/DelayEmbedding.hh>
+#include <rlfd/utils/DistanceStore.hh>
+#include <rlfd/segment/ChangePoints.hh>
 
 #include <Eigen/Core>
 
 namespace rlfd {
 namespace segment {
 
+namespace detail {
+
+template<typename Columns>
+double CSegmentation(Columns& distances, double C, Eigen::VectorXi& states)
+{
+  const int T = distances.Size();
+  states.resize(T);
+  if (T == 0) {
+    return 0.0;
+  }
+
+  // Only the costs at t-1 and t are kept. A path ending in state s at t has
+  // stayed in s since entry[s], and switched from the best path at entry[s]-1.
+  Eigen::VectorXd previous = distances.Column(0);
+  Eigen::VectorXd current(T);
+  Eigen::VectorXi entry = Eigen::VectorXi::Zero(T);
+
+  // The best state at each t, and the time at which its path entered it
+  Eigen::VectorXi best(T);
+  Eigen::VectorXi bestEntry(T);
+  previous.minCoeff(&best[0]);
+  bestEntry[0] = 0;
+
+  // t = 2..T
+  for (int t = 1; t < T; t++) {
+    double h = previous[best[t-1]] + C;
+    const Eigen::VectorXd& distance = distances.Column(t);
+    for (int s = 0; s < T; s++) {
+      if (previous[s] <= h) {
+        current[s] = distance[s] + previous[s];
+      } else {
+        current[s] = distance[s] + h;
+        entry[s] = t;
+      }
+    }
+    current.minCoeff(&best[t]);
+    bestEntry[t] = entry[best[t]];
+    previous.swap(current);
+  }
+
+  // Termination at t = T: backtrack through the switches
+  for (int t = T - 1; t >= 0; ) {
+    int s = best[t];
+    int e = bestEntry[t];
+    states.segment(e, t - e + 1).setConstant(s);
+    t = e - 1;
+  }
+
+  return previous.minCoeff();
+}
+
+} // namespace detail
+
 /**
  * Implements the C-Segmentation algorithm from:
  *
@@ -35,36 +90,35 @@ namespace segment {
  * Proceedings of the 13th International IEEE workshop on Neural Networks for
  * Signal Processing, 2003, pp. 449–458.
  *
+ * Runs in O(T) memory: the optimal path is recovered from the best state at
+ * each time and the time at which its path entered that state.
+ *
  * @param distances The pre-computed distance matrix for the vectors of ts
  * @param C The regularization constant
+ * @param states Output state of the optimal path at each time, given as the
+ * index of the window whose density represents the segment
+ * @return The cost of the optimal path
  */
 template<typename Derived>
-void CSegmentation(const Eigen::MatrixBase<Derived>& distances, double C)
+double CSegmentation(const Eigen::MatrixBase<Derived>& distances, double C, Eigen::VectorXi& states)
 {
-  unsigned T = distances.cols();
-
-  // Init t = 1
-  Eigen::MatrixXd opaths(T, T);
-  opaths.setZero();
-  opaths.col(0) = distances.col(0);
-
-  // t = 2..T
-  for (int t = 1; t < opaths.cols(); t++) {
-    double h = opaths.col(t-1).minCoeff() + C;
-    for (int s = 0; s < opaths.rows(); s++) {
-      opaths(s, t) = (t > s ? distances(t, s) : distances(s, t)) + std::min(opaths(s, t-1), h);
-    }
-  }
-
-  // Termination at t = T
-  for (int t = 0; t < opaths.cols(); t++) {
-    int i;
-    opaths.col(t).minCoeff(&i);
-    std::cout << i << std::endl;
-  }
-
+  rlfd::utils::DenseColumns<Derived> columns(distances);
+  return detail::CSegmentation(columns, C, states);
 }
 
+/**
+ * C-Segmentation over a distance matrix stored on disk, read one panel of
+ * columns at a time.
+ * @param distances The pre-computed distance matrix for the vectors of ts
+ * @param C The regularization constant
+ * @param states Output state of the optimal path at each time
+ * @return The cost of the optimal path
+ */
+double CSegmentation(rlfd::utils::DistanceStore& distances, double C, Eigen::VectorXi& states)
+{
+  rlfd::utils::TiledColumns columns(distances);
+  return detail::CSegmentation(columns, C, states);
+}
 
 } // namespace segmentation
 } // namespace rlfd
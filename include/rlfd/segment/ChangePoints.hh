@@ -0,0 +1,47 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __CHANGEPOINTS_HH__
+#define __CHANGEPOINTS_HH__
+
+#include <vector>
+#include <Eigen/Core>
+
+namespace rlfd {
+namespace segment {
+
+/**
+ * @param states The state at each time
+ * @param changes Output times at which the state differs from the previous one
+ */
+void ChangePoints(const Eigen::VectorXi& states, Eigen::VectorXi& changes)
+{
+  std::vector<int> times;
+  for (int t = 1; t < states.size(); t++) {
+    if (states[t] != states[t-1]) {
+      times.push_back(t);
+    }
+  }
+  changes = Eigen::Map<const Eigen::VectorXi>(times.data(), times.size());
+}
+
+} // namespace segment
+} // namespace rlfd
+
+#endif
@@ -20,91 +20,597 @@
 #ifndef __KOHLMORGEN_LEMM_HH__
 #define __KOHLMORGEN_LEMM_HH__
 
-#include <rlfd/Model.hh>
-#include <rlfd/delay/DelayEmbedding.hh>
+#include <rlfd/stats/GaussianDensityEstimator.hh>
+#include <rlfd/stats/GaussianKernel.hh>
+#include <rlfd/stats/WindowCache.hh>
 
 #include <Eigen/Core>
+#include <deque>
+#include <limits>
 #include <vector>
 #include <memory>
-#include <numeric>
+#include <algorithm>
 
 namespace rlfd {
 namespace segment {
 
 /**
- * A class to perform time series segmentation.
- * It takes as a argument a Model type
+ * On-line time series segmentation, one sample at a time.
  *
  * Kohlmorgen, J., & Lemm, S. (2001). A dynamic HMM for on-line segmenation of
  * sequation data. Advances in Neural Information Processing Systems 14 (NIPS
  * 2001) (pp. 793-800). Vancouver, British Columbia, Canada: MIT Press.
+ *
+ * Every window of W samples becomes a candidate state when it is complete,
+ * and its density is compared to the other windows through the integrated
+ * squared error of their Gaussian kernel estimates. Each state keeps the
+ * kernel sum between its window and the latest one, updated with the entering
+ * and leaving samples in 2W kernel evaluations.
+ *
+ * As in the original algorithm, a new state is first evaluated over the past
+ * windows: its cost is computed at every earlier time, and lowers the optimal
+ * cost of the times where it does better. This requires the past samples, the
+ * optimal costs and paths at every time, and the self sums and packed samples
+ * of the past windows, held in a window cache which the states share.
+ *
+ * Once the cost of a state exceeds the optimum plus C, switching from the
+ * optimal path is at least as good as any path that stayed in it: its history
+ * no longer matters, and it is re-entered from the optimal path at the next
+ * step. The state itself cannot be dropped safely, since it can always be
+ * re-entered at the optimum plus C and its distance to the coming windows may
+ * be arbitrarily small.
+ *
+ * The exact algorithm thus keeps every state and the whole sequence, and its
+ * memory and work per sample grow linearly with the sequence. By default, a
+ * horizon of DefaultHorizon times W windows approximates it in bounded memory
+ * and time per sample: a new state is only evaluated over the windows of the
+ * horizon, entering them from the optimum before, a state which spent the
+ * whole horizon above the optimum plus C is dropped, and at most as many
+ * states as the horizon are kept, the most expensive being evicted. The
+ * lifetime and the cap on the states may be set separately, and a horizon of
+ * 0 runs the exact algorithm.
+ *
+ * Changes of state are reported once all the candidate paths agree on them,
+ * including the paths a future state could branch from, which are those of
+ * the horizon. Without a horizon, a future state may be optimal since the
+ * first window, so that nothing is certain before Flush(). Times and states
+ * are window indices: window t holds the samples t to t+W-1.
  */
-template <class DistanceFunctorType>
 class KohlmorgenLemm
 {
  public:
-  KohlmorgenLemm(DistanceFunctorType& distanceFunctor, int W=50, double C=0.0) :
-      distanceFunctor(&distanceFunctor), W(W), regularizer(C)
+  /**
+   * The start of a segment of the optimal path
+   */
+  struct ChangePoint {
+    // The first window of the segment
+    int time;
+    // The window whose density represents the segment
+    int state;
+  };
+
+  /**
+   * @param kde The density estimator, which provides sigma, the
+   * dimensionality of the samples and the method summing the kernel terms
+   * between whole windows
+   * @param W The window size
+   * @param C The regularization constant
+   */
+  KohlmorgenLemm(rlfd::stats::GaussianDensityEstimator& kde, int W=50, double C=0.0) :
+      W_(W), d_(kde.GetDimensionality()), regularizer_(C),
+      k_(kde.GetKernelFactor()), normalization_(kde.GetNormalization(W)),
+      summation_(kde.GetSummation()), history_(2*W, (int) kde.GetDimensionality()),
+      first_(0), samples_(0), T_(-1), selfSum_(0.0),
+      windows_(std::numeric_limits<size_t>::max()), origin_(0), horizon_(0),
+      optimum_(0.0), best_(0), lastChange_(-1), lifetime_(-1), maxStates_(0),
+      statistics_(), activeSum_(0.0)
   {
-    cpaths.resize(1, 0.0);
-    opaths.resize(1, 0.0);
-    distances.resize(1, 0.0);
+    SetHorizon(DefaultHorizon*W);
   }
 
   virtual ~KohlmorgenLemm() {};
 
+  /**
+   * Regularization constant C that subsumes varsigma and k
+   */
+  double GetRegularizer() { return regularizer_; }
+
+  int GetWindowSize() { return W_; }
+
+  /**
+   * Counters on the candidate states since the first window
+   */
+  struct Statistics {
+    // Currently active
+    size_t active;
+    // Largest number active at once
+    size_t peak;
+    // Mean number active per window
+    double mean;
+    // Windows that became states
+    size_t created;
+    // Dropped after their lifetime above the bound
+    size_t pruned;
+    // Dropped to respect the cap on active states
+    size_t evicted;
+  };
+
+  /**
+   * The default horizon, as a multiple of the window size
+   */
+  static const int DefaultHorizon = 10;
+
+  /**
+   * @param horizon The number of past windows over which a new state is
+   * evaluated, which is also the default lifetime and cap on the number of
+   * states, or 0 to evaluate it over all of them and keep every state, as the
+   * exact algorithm does. A positive horizon bounds the memory and the work
+   * per sample, but approximates the segmentation. Default DefaultHorizon*W.
+   */
+  void SetHorizon(int horizon)
+  {
+    horizon_ = std::max(horizon, 0);
+    windows_.SetCapacity(horizon_ > 0 ? horizon_ + 2 : std::numeric_limits<size_t>::max());
+  }
+
+  int GetHorizon() { return horizon_; }
+
+  /**
+   * Approximate the segmentation by dropping the states which stay above the
+   * optimum plus C.
+   * @param lifetime The number of consecutive steps a state may cost more
+   * than the optimum plus C before it is dropped. 0 drops it immediately, and
+   * a negative value, the default, uses the horizon, or keeps every state
+   * without a horizon.
+   */
+  void SetLifetime(int lifetime) { lifetime_ = lifetime; }
+
+  int GetLifetime() { return lifetime_; }
+
+  /**
+   * Approximate the segmentation by bounding the number of states.
+   * @param maxStates The maximal number of active states, the most expensive
+   * ones being evicted first, or 0, the default, for as many as the horizon,
+   * or no limit without a horizon.
+   */
+  void SetMaxStates(size_t maxStates) { maxStates_ = maxStates; }
+
+  size_t GetMaxStates() { return maxStates_; }
+
+  Statistics GetStatistics()
+  {
+    Statistics statistics = statistics_;
+    statistics.active = states_.size();
+    statistics.mean = T_ < 0 ? 0.0 : activeSum_/(T_ + 1.0);
+    return statistics;
+  }
+
+  /**
+   * @return The index of the latest window, or -1 before the first W samples
+   */
+  int GetTime() { return T_; }
+
+  /**
+   * @return The number of candidate states
+   */
+  size_t GetActiveStates() { return states_.size(); }
+
+  /**
+   * @return The cost of the optimal path up to the latest window
+   */
+  double GetCost() { return optimum_; }
+
+  /**
+   * @return The state of the optimal path at the latest window, or -1
+   */
+  int GetBestState() { return states_.empty() ? -1 : states_[best_].id; }
+
+  /**
+   * Process one sample.
+   * @param x A vector of the dimensionality of the density estimator
+   * @param changes Receives the segments of the optimal path which became
+   * certain with this sample, in increasing order of time
+   */
+  template<typename Derived>
+  void AddObservation(const Eigen::MatrixBase<Derived>& x, std::vector<ChangePoint>& changes)
+  {
+    Append(x);
+
+    // Fill the first window
+    if (samples_ < W_) {
+      return;
+    }
+    if (samples_ == W_) {
+      T_ = 0;
+      Eigen::MatrixXd window = Pack(0);
+      selfSum_ = CrossSum(window, window);
+      states_.push_back(State{0, 0, windows_.Put(0, window, selfSum_), selfSum_, 0.0, 0, nullptr});
+      optimum_ = 0.0;
+      best_ = 0;
+      Record();
+      Count();
+      return;
+    }
+
+    // Slide the latest window by one sample
+    T_++;
+    selfSum_ -= 2.0*KernelSum(Sample(T_ - 1), WindowData(T_ - 1), HistoryStride()) - 1.0;
+    selfSum_ += 2.0*KernelSum(Sample(T_ + W_ - 1), WindowData(T_), HistoryStride()) - 1.0;
+
+    // Recompute the running sums every W steps to bound their drift
+    Eigen::MatrixXd window = Pack(T_);
+    if (T_ % W_ == 0) {
+      selfSum_ = CrossSum(window, window);
+    }
+
+    // The latest window enters as a new state, evaluated over the past
+    State latest{T_, 0, windows_.Put(T_, window, selfSum_), selfSum_, 0.0, 0, nullptr};
+    EvaluatePast(latest);
+
+    // States switching at T come from the optimal path at T-1
+    const double h = Optimum(T_ - 1) + regularizer_;
+    const std::shared_ptr<PathNode>& switchNode = OptimalPath(T_ - 1);
+
+    const double* entering = Sample(T_ + W_ - 1);
+    const double* leaving = Sample(T_ - 1);
+    for (State& state : states_) {
+      const Eigen::MatrixXd& data = state.window->data;
+      if ((T_ - state.id) % W_ == 0) {
+        state.crossSum = CrossSum(data, window);
+      } else {
+        state.crossSum += KernelSum(entering, data.data(), W_) - KernelSum(leaving, data.data(), W_);
+      }
+      Step(state, normalization_*(state.window->selfSum + selfSum_ - 2.0*state.crossSum), h, switchNode);
+    }
+
+    // At distance 0 from itself
+    Step(latest, 0.0, h, switchNode);
+    states_.push_back(std::move(latest));
+
+    FindOptimum();
+    Prune();
+    Record();
+    Count();
+    Decide(changes);
+  }
+
+  /**
+   * Report the segments of the current optimal path which have not been
+   * reported yet, as if the sequence ended with the latest sample.
+   */
+  void Flush(std::vector<ChangePoint>& changes)
+  {
+    if (states_.empty()) {
+      return;
+    }
+    Report(OptimalPath(T_).get(), changes);
+  }
+
  protected:
-  std::vector<double> cpaths;
-  std::vector<double> opaths;
-  std::vector<double> distances;
+  /**
+   * A segment of a path, linked to the segments before it
+   */
+  struct PathNode {
+    int state;
+    int entry;
+    int end;
+    std::shared_ptr<PathNode> parent;
+  };
 
-  DistanceFunctorType* distanceFunctor;
+  struct State {
+    // The window that defines the state
+    int id;
+    // When the path ending in this state entered it
+    int entry;
+    // Its samples and self sum, shared with the window cache
+    std::shared_ptr<const rlfd::stats::WindowCache::Window> window;
+    // Kernel sum with the latest window
+    double crossSum;
+    double cost;
+    // Consecutive steps spent above the optimum plus C
+    int exceeded;
+    // The path before entry, or null for the start of the sequence
+    std::shared_ptr<PathNode> parent;
+  };
 
-  int W;
-  double regularizer;
+  /**
+   * Append a sample to the history, dropping the samples before the origin
+   * when the buffer is full, and growing it otherwise.
+   */
+  template<typename Derived>
+  void Append(const Eigen::MatrixBase<Derived>& x)
+  {
+    int used = samples_ - first_;
+    if (used == history_.rows()) {
+      int dropped = origin_ - first_;
+      if (dropped > 0) {
+        used -= dropped;
+        history_.topRows(used) = history_.middleRows(dropped, used).eval();
+        first_ = origin_;
+      }
+      if (2*used > history_.rows()) {
+        history_.conservativeResize(2*history_.rows(), d_);
+      }
+    }
+    history_.row(used) = x.template cast<double>().transpose();
+    samples_++;
+  }
 
- public:
   /**
-   * Regularization constant C that subsumes varsigma and k
+   * Extend the path of a state to the latest window, switching from the
+   * optimal path if it is cheaper than staying.
    */
-  double GetRegularizer() { return regularizer; }
+  void Step(State& state, double distance, double h, const std::shared_ptr<PathNode>& switchNode)
+  {
+    if (state.cost <= h) {
+      state.cost += distance;
+    } else {
+      state.cost = h + distance;
+      state.entry = T_;
+      state.parent = switchNode;
+    }
+  }
 
-  void AddObservation(const Eigen::MatrixXd& embTs, int T)
+  /**
+   * Compute the cost of the latest window as a state at every past time from
+   * the start of the horizon, lowering the optimal costs and paths of the
+   * times where it does better. Its cross sum with the past windows slides
+   * with them, and is recomputed every W steps.
+   * @param latest Receives the cost, entry and path of the state at T-1
+   */
+  void EvaluatePast(State& latest)
   {
-    auto latest_window = embTs.block(T-(W-1), 0, W, embTs.cols());
+    const int start = horizon_ > 0 ? std::max(T_ - horizon_, 0) : 0;
+    const Eigen::MatrixXd& data = latest.window->data;
+    double crossSum = 0.0;
+    for (int t = start; t < T_; t++) {
+      std::shared_ptr<const rlfd::stats::WindowCache::Window> past = PastWindow(t);
+      if ((t - start) % W_ == 0) {
+        crossSum = CrossSum(data, past->data);
+      } else {
+        crossSum += KernelSum(Sample(t + W_ - 1), data.data(), W_) - KernelSum(Sample(t - 1), data.data(), W_);
+      }
+      double distance = normalization_*(selfSum_ + past->selfSum - 2.0*crossSum);
 
-    // C_T(T-1)
-    double cpath_latest = 0.0;
-    for (unsigned t = 0; t < cpaths.size(); t++) {
       if (t == 0) {
-        cpath_latest = 0.0;
+        latest.cost = distance;
+        latest.entry = 0;
+        latest.parent.reset();
+      } else if (t == start || latest.cost > Optimum(t - 1) + regularizer_) {
+        latest.cost = Optimum(t - 1) + regularizer_ + distance;
+        latest.entry = t;
+        latest.parent = OptimalPath(t - 1);
       } else {
-        cpath_latest = std::min(cpath_latest, opaths[t-1] + GetRegularizer());
+        latest.cost += distance;
+      }
+
+      if (latest.cost < Optimum(t)) {
+        optima_[t - origin_] = latest.cost;
+        optimal_[t - origin_].reset(new PathNode{T_, latest.entry, t, latest.parent});
       }
+    }
+  }
 
-      auto window_t = embTs.block(t, 0, W, embTs.cols());
-      distances[t] = (*distanceFunctor)(latest_window, window_t);
-      cpath_latest += distances[t];
+  /**
+   * Keep the optimal cost and path of the latest window, and forget those
+   * which fell out of the horizon. The cache evicts the windows alike.
+   */
+  void Record()
+  {
+    const State& best = states_[best_];
+    optima_.push_back(optimum_);
+    optimal_.push_back(std::shared_ptr<PathNode>(new PathNode{best.id, best.entry, T_, best.parent}));
+
+    // The next window is evaluated from T+1-horizon, entered from the time before
+    while (horizon_ > 0 && origin_ < T_ - horizon_) {
+      optima_.pop_front();
+      optimal_.pop_front();
+      origin_++;
+    }
+  }
+
+  double Optimum(int t) { return optima_[t - origin_]; }
+
+  const std::shared_ptr<PathNode>& OptimalPath(int t) { return optimal_[t - origin_]; }
+
+  /**
+   * @return The statistics of window t from the cache, or recomputed from the
+   * history if they were evicted
+   */
+  std::shared_ptr<const rlfd::stats::WindowCache::Window> PastWindow(int t)
+  {
+    std::shared_ptr<const rlfd::stats::WindowCache::Window> window = windows_.Find(t);
+    if (window == nullptr) {
+      Eigen::MatrixXd data = Pack(t);
+      window = windows_.Put(t, data, CrossSum(data, data));
+    }
+    return window;
+  }
+
+  /**
+   * @return Sample i of the history, its coordinates spaced by HistoryStride()
+   */
+  const double* Sample(int i) { return history_.data() + (i - first_); }
+
+  /**
+   * @return The first sample of window t, its samples stored column-major with
+   * a stride of HistoryStride()
+   */
+  const double* WindowData(int t) { return Sample(t); }
+
+  int HistoryStride() { return history_.rows(); }
+
+  /**
+   * @return The samples of window t, packed
+   */
+  Eigen::MatrixXd Pack(int t) { return history_.block(t - first_, 0, W_, d_); }
+
+  /**
+   * Sum of the kernel terms between a sample of the history and the W samples
+   * starting at y.
+   */
+  double KernelSum(const double* x, const double* y, int ystride)
+  {
+    return rlfd::stats::GaussianKernelSum(x, HistoryStride(), y, ystride, W_, d_, k_);
+  }
+
+  double CrossSum(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y)
+  {
+    return summation_.Sum(X, Y, k_);
+  }
 
-      if (cpath_latest < opaths[t]) {
-        opaths[t] = cpath_latest;
-        std::cerr << "Updating opath" << std::endl;
+  void FindOptimum()
+  {
+    best_ = 0;
+    for (size_t i = 1; i < states_.size(); i++) {
+      if (states_[i].cost < states_[best_].cost) {
+        best_ = i;
       }
     }
-    std::cerr << "C_T(T-1) " << cpath_latest << std::endl;
-    cpaths.push_back(cpath_latest);
-    distances.push_back(0.0);
+    optimum_ = states_[best_].cost;
+  }
+
+  /**
+   * Drop the states which spent more than their lifetime above the optimum
+   * plus C, then the most expensive ones beyond the cap, when these
+   * approximations are enabled, explicitly or by the horizon.
+   */
+  void Prune()
+  {
+    const double bound = optimum_ + regularizer_;
+    for (State& state : states_) {
+      state.exceeded = (state.cost > bound) ? state.exceeded + 1 : 0;
+    }
+
+    const int lifetime = (lifetime_ >= 0 || horizon_ == 0) ? lifetime_ : horizon_;
+    const size_t maxStates = (maxStates_ > 0) ? maxStates_ : horizon_;
+
+    size_t active = states_.size();
+    if (lifetime >= 0) {
+      states_.erase(std::remove_if(states_.begin(), states_.end(), [&](const State& state) {
+        return state.exceeded > lifetime;
+      }), states_.end());
+    }
+    statistics_.pruned += active - states_.size();
+
+    // The optimal state is the cheapest, and is never evicted
+    if (maxStates > 0 && states_.size() > maxStates) {
+      std::nth_element(states_.begin(), states_.begin() + maxStates, states_.end(),
+                       [](const State& a, const State& b) { return a.cost < b.cost; });
+      statistics_.evicted += states_.size() - maxStates;
+      states_.erase(states_.begin() + maxStates, states_.end());
+    }
+
+    FindOptimum();
+  }
+
+  /**
+   * Update the statistics after a new window became a state.
+   */
+  void Count()
+  {
+    statistics_.created++;
+    statistics_.peak = std::max(statistics_.peak, states_.size());
+    activeSum_ += states_.size();
+  }
+
+  /**
+   * Report the segments shared by all the candidate paths: those of the
+   * states, and the optimal paths of the horizon, from which a future state
+   * may switch.
+   */
+  void Decide(std::vector<ChangePoint>& changes)
+  {
+    // A future state may start a path of its own at the first window
+    if (origin_ == 0) {
+      return;
+    }
 
-    // C_T(T)
-    for (unsigned t = 0; t < cpaths.size(); t++) {
-      cpaths[t] = distances[t] + std::min(cpaths[t], opaths.back() + GetRegularizer());
+    // Walk back the latest of the histories until they all meet
+    std::vector<PathNode*> nodes;
+    for (const State& state : states_) {
+      nodes.push_back(state.parent.get());
     }
-    std::cerr << "C_T(T) updated" << std::endl;
+    for (const std::shared_ptr<PathNode>& node : optimal_) {
+      nodes.push_back(node.get());
+    }
+    while (true) {
+      PathNode* latest = nullptr;
+      for (PathNode* node : nodes) {
+        if (node == nullptr) {
+          return;
+        }
+        if (latest == nullptr || node->end > latest->end) {
+          latest = node;
+        }
+      }
+      if (std::all_of(nodes.begin(), nodes.end(), [&](PathNode* node) { return node == latest; })) {
+        Report(latest, changes);
+        latest->parent.reset();
+        return;
+      }
+      // A segment ends strictly before the ones that follow it, so that none
+      // of the latest segments can be an ancestor of another path
+      for (PathNode*& node : nodes) {
+        if (node->end == latest->end) {
+          node = node->parent.get();
+        }
+      }
+    }
+  }
 
-    // Choose the state with the minimum cost
-    opaths.push_back((*std::min_element(cpaths.begin(), cpaths.end())));
+  /**
+   * Report the segments of a path that start after the last one reported.
+   */
+  void Report(const PathNode* node, std::vector<ChangePoint>& changes)
+  {
+    std::vector<ChangePoint> segments;
+    for (; node != nullptr && node->entry > lastChange_; node = node->parent.get()) {
+      segments.push_back(ChangePoint{node->entry, node->state});
+    }
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+      changes.push_back(*it);
+    }
+    if (!segments.empty()) {
+      lastChange_ = segments.front().time;
+    }
   }
 
+  int W_;
+  int d_;
+  double regularizer_;
+  double k_;
+  double normalization_;
+  rlfd::stats::KernelSummation summation_;
+
+  // The samples since first_, column-major so that every window is a
+  // contiguous block of rows
+  Eigen::MatrixXd history_;
+  int first_;
+  int samples_;
+
+  // The latest window and its self kernel sum
+  int T_;
+  double selfSum_;
+
+  // The windows from the origin to T, and those of the states
+  rlfd::stats::WindowCache windows_;
+
+  // The optimal costs and paths from the origin to T
+  std::deque<double> optima_;
+  std::deque<std::shared_ptr<PathNode>> optimal_;
+  int origin_;
+  int horizon_;
+
+  std::vector<State> states_;
+  double optimum_;
+  size_t best_;
+  int lastChange_;
+
+  int lifetime_;
+  size_t maxStates_;
+  Statistics statistics_;
+  double activeSum_;
 };
 
 } // namespace segmentation
@@ -22,12 +22,124 @@
 
 #include <rlfd/Model.hh>
 #include <rlfd/delay/DelayEmbedding.hh>
+#include <rlfd/utils/DistanceStore.hh>
 
+#include <limits>
+#include <algorithm>
 #include <Eigen/Core>
 
 namespace rlfd {
 namespace segment {
 
+namespace detail {
+
+/**
+ * Find the smallest and second smallest entries of a column, the first one
+ * found winning ties.
+ */
+template<typename Vector>
+void BestTwo(const Vector& column, int& best, int& second)
+{
+  best = 0;
+  second = -1;
+  for (int s = 1; s < column.size(); s++) {
+    if (column[s] < column[best]) {
+      second = best;
+      best = s;
+    } else if (second < 0 || column[s] < column[second]) {
+      second = s;
+    }
+  }
+}
+
+template<typename Columns>
+void NSegmentation(Columns& distances, unsigned N, Eigen::VectorXd& costs, Eigen::MatrixXi& states)
+{
+  const int T = distances.Size();
+  const double inf = std::numeric_limits<double>::infinity();
+
+  costs = Eigen::VectorXd::Constant(N, inf);
+  states = Eigen::MatrixXi::Constant(N, T, -1);
+  if (T == 0 || N == 0) {
+    return;
+  }
+
+  // Costs of the paths made of n+1 segments at t-1 and t, one column per n.
+  // A path ending in state s has stayed in it since entry(s, n), and came
+  // from the best path with n segments not ending in s.
+  Eigen::MatrixXd previous = Eigen::MatrixXd::Constant(T, N, inf);
+  Eigen::MatrixXd current = Eigen::MatrixXd::Constant(T, N, inf);
+  Eigen::MatrixXi entry = Eigen::MatrixXi::Zero(T, N);
+
+  // The two best states for each n and t, and when their paths entered them
+  Eigen::MatrixXi best = Eigen::MatrixXi::Constant(N, T, -1);
+  Eigen::MatrixXi bestEntry = Eigen::MatrixXi::Zero(N, T);
+  Eigen::MatrixXi second = Eigen::MatrixXi::Constant(N, T, -1);
+  Eigen::MatrixXi secondEntry = Eigen::MatrixXi::Zero(N, T);
+
+  // Initialization at t = 0
+  previous.col(0) = distances.Column(0);
+  BestTwo(previous.col(0), best(0, 0), second(0, 0));
+
+  // Recursion t = 1 .. T. Paths of n+1 segments cannot exist before t = n.
+  for (int t = 1; t < T; t++) {
+    const Eigen::VectorXd& distance = distances.Column(t);
+    const int levels = std::min<int>(N, t + 1);
+
+    current.col(0) = distance + previous.col(0);
+    for (int n = 1; n < levels; n++) {
+      const int b = best(n-1, t-1);
+      const int b2 = second(n-1, t-1);
+      const double minBest = previous(b, n-1);
+      const double minSecond = b2 < 0 ? inf : previous(b2, n-1);
+
+      for (int s = 0; s < T; s++) {
+        double h = (s != b) ? minBest : minSecond;
+        if (previous(s, n) <= h) {
+          current(s, n) = distance[s] + previous(s, n);
+        } else {
+          current(s, n) = distance[s] + h;
+          entry(s, n) = t;
+        }
+      }
+    }
+
+    for (int n = 0; n < levels; n++) {
+      BestTwo(current.col(n), best(n, t), second(n, t));
+      bestEntry(n, t) = entry(best(n, t), n);
+      secondEntry(n, t) = second(n, t) < 0 ? 0 : entry(second(n, t), n);
+    }
+    previous.swap(current);
+  }
+
+  // Termination: backtrack every path whose cost is finite
+  for (int n = 0; n < (int) N; n++) {
+    if (best(n, T-1) < 0 || !(previous(best(n, T-1), n) < inf)) {
+      continue;
+    }
+    costs[n] = previous(best(n, T-1), n);
+
+    int s = best(n, T-1);
+    int e = bestEntry(n, T-1);
+    for (int t = T - 1, k = n; ; k--) {
+      states.row(n).segment(e, t - e + 1).setConstant(s);
+      if (k == 0) {
+        break;
+      }
+      t = e - 1;
+      if (best(k-1, t) != s) {
+        s = best(k-1, t);
+        e = bestEntry(k-1, t);
+      } else {
+        s = second(k-1, t);
+        e = secondEntry(k-1, t);
+      }
+    }
+  }
+}
+
+} // namespace detail
+
 /**
  * Implements the N-Segmentation algorithm from:
  *
@@ -35,72 +147,38 @@ namespace segment {
  * Proceedings of the 13th International IEEE workshop on Neural Networks for
  * Signal Processing, 2003, pp. 449–458.
  *
+ * Only the current columns of the N cost matrices are kept. The paths are
+ * recovered from the two best states of each column, which is also all the
+ * recursion needs to find the best predecessor in another state.
+ *
  * @param distances The pre-computed distance matrix for the vectors of ts
- * @param C The regularization constant
+ * @param N The maximal number of segments
+ * @param costs Output cost of the optimal path made of n+1 segments, at n.
+ * Infinite when there is no such path.
+ * @param states Output N x T matrix with the states of the optimal path made
+ * of n+1 segments on row n, or -1 when there is no such path.
  */
 template<typename Derived>
-void NSegmentation(const Eigen::MatrixBase<Derived>& distances, unsigned N)
+void NSegmentation(const Eigen::MatrixBase<Derived>& distances, unsigned N, Eigen::VectorXd& costs, Eigen::MatrixXi& states)
 {
-
-  unsigned T = distances.cols();
-
-  // Maunsignedain the costs for n-segments segmentations
-  std::vector<Eigen::MatrixXd> costs;
-  costs.resize(N);
-
-  // Initialization at t = 0 
-  costs[0].resize(T, T);
-  costs[0].setZero();
-  costs[0].col(0) = distances.col(0);
-//  std::cout << costs[0].col(0) << std::endl; 
-
-  for (unsigned i = 1; i < N; i++) {
-    costs[i].resize(T, T);
-    costs[i].setZero();
-    costs[i].col(0) = Eigen::VectorXd::Constant(T, std::numeric_limits<double>::infinity());
-  }  
-
-  // Recusion t = 1 .. T
-  Eigen::MatrixXd::Index minIndex;
-  double minUnconstrained = 0.0;
-
-  for (unsigned t = 1; t < T; t++) {
-    for (unsigned n = 0; n < N; n++) {
-      for (unsigned s = 0; s < T; s++) {
-        double distance = t > s ? distances(t, s) : distances(s, t);
-        if (n != 0) {
-          if ((unsigned) minIndex != s) {
-            (costs[n])(s, t) = distance + std::min((costs[n])(s, t - 1), minUnconstrained); 
-          } else {
-
-            auto segmentA = costs[n-1].col(t-1).segment(0, s);
-            double minA = std::numeric_limits<double>::infinity(); 
-            if (segmentA.size() != 0) {
-              minA = segmentA.minCoeff();
-            }
-
-            auto segmentB = costs[n-1].col(t-1).segment(s+1, T-(s+1));
-            double minB = std::numeric_limits<double>::infinity(); 
-            if (segmentB.size() != 0) {
-              minB = segmentB.minCoeff();
-            }
-
-            (costs[n])(s, t) = distance + std::min((costs[n])(s, t - 1), std::min(minA, minB)); 
-          }
-        } else {
-          (costs[n])(s, t) = distance + (costs[n])(s, t - 1);
-        }
-      } // for all s
-      minUnconstrained = costs[n].col(t-1).minCoeff(&minIndex); 
-    } 
-  } 
-
-  // Termination 
-  for (unsigned n = 0; n < N; n++) {
-    std::cout << n+1 << "    " << costs[n].col(T-1).minCoeff(&minIndex) << std::endl;
-  }
+  rlfd::utils::DenseColumns<Derived> columns(distances);
+  detail::NSegmentation(columns, N, costs, states);
 }
 
+/**
+ * N-Segmentation over a distance matrix stored on disk, read one panel of
+ * columns at a time.
+ * @param distances The pre-computed distance matrix for the vectors of ts
+ * @param N The maximal number of segments
+ * @param costs Output cost of the optimal path made of n+1 segments, at n
+ * @param states Output states of the optimal path made of n+1 segments, on
+ * row n
+ */
+void NSegmentation(rlfd::utils::DistanceStore& distances, unsigned N, Eigen::VectorXd& costs, Eigen::MatrixXi& states)
+{
+  rlfd::utils::TiledColumns columns(distances);
+  detail::NSegmentation(columns, N, costs, states);
+}
 
 } // namespace segmentation
 } // namespace rlfd
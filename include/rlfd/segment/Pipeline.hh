@@ -0,0 +1,245 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __PIPELINE_HH__
+#define __PIPELINE_HH__
+
+#include <rlfd/delay/DelayEmbedding.hh>
+#include <rlfd/stats/GaussianDensityEstimator.hh>
+#include <rlfd/utils/DistanceStore.hh>
+#include <rlfd/utils/ImportExport.hh>
+#include <rlfd/segment/CSegmentation.hh>
+#include <rlfd/segment/NSegmentation.hh>
+
+#include <string>
+#include <stdexcept>
+#include <Eigen/Core>
+
+namespace rlfd {
+namespace segment {
+
+/**
+ * Delay embedding, bandwidth calibration, distance computation and
+ * segmentation of a time series, in a single process. The channels of a
+ * multichannel series are segmented jointly, from their concatenated delay
+ * vectors.
+ *
+ * Every stage works on the buffers of the previous one, and the delay vectors
+ * of a scalar series are read in place. They and the distances can be
+ * spilled to files on the way, but are never read back.
+ * With a tiled store, the distances go to disk one tile at a time and the
+ * segmentation reads them back one panel at a time instead.
+ */
+class Pipeline
+{
+ public:
+  /**
+   * @param m The embedding dimension of every channel
+   * @param lag The lag value of every channel
+   * @param W The window size
+   */
+  Pipeline(int m = 2, int lag = 1, int W = 50) :
+      m_(Eigen::VectorXi::Constant(1, m)), lag_(Eigen::VectorXi::Constant(1, lag)), W_(W),
+      sigma_(0.0), bandwidth_(0.0), threads_(1),
+      backend_(rlfd::stats::GaussianDensityEstimator::Backend::Incremental), tolerance_(1e-12),
+      tiled_(false) {};
+
+  /**
+   * @param m The embedding dimension of each channel
+   * @param lag The lag value of each channel
+   * @param W The window size
+   */
+  Pipeline(const Eigen::VectorXi& m, const Eigen::VectorXi& lag, int W = 50) :
+      m_(m), lag_(lag), W_(W), sigma_(0.0), bandwidth_(0.0), threads_(1),
+      backend_(rlfd::stats::GaussianDensityEstimator::Backend::Incremental), tolerance_(1e-12),
+      tiled_(false) {};
+
+  /**
+   * @param sigma The kernel bandwidth. Estimated from the delay vectors when
+   * not positive.
+   */
+  void SetSigma(double sigma) { sigma_ = sigma; }
+
+  /**
+   * @return The kernel bandwidth used by the last call to Run
+   */
+  double GetBandwidth() { return bandwidth_; }
+
+  /**
+   * @param threads The number of threads computing the distances. 0 means one
+   * per core.
+   */
+  void SetThreads(unsigned threads) { threads_ = threads; }
+
+  /**
+   * How the density estimator computes the kernel sums between windows.
+   * @param tolerance The error allowed in each distance by the Truncated backend
+   */
+  void SetBackend(rlfd::stats::GaussianDensityEstimator::Backend backend, double tolerance = 1e-12)
+  {
+    backend_ = backend;
+    tolerance_ = tolerance;
+  }
+
+  void SetSummation(const rlfd::stats::KernelSummation& summation) { summation_ = summation; }
+
+  /**
+   * Write the delay vectors to this file once computed. Binary if it ends
+   * with .bin, tabular text otherwise.
+   */
+  void SetEmbeddingSpill(const std::string& filename) { embeddingSpill_ = filename; }
+
+  /**
+   * Write the distances to this file once computed. Binary if it ends with
+   * .bin, tabular text otherwise. Ignored with a tiled store.
+   */
+  void SetDistanceSpill(const std::string& filename) { distanceSpill_ = filename; }
+
+  /**
+   * Hold the distances in a tiled store at this location instead of memory.
+   */
+  void SetTiledStore(const std::string& filename) { tiledStore_ = filename; }
+
+  /**
+   * Embed ts, calibrate the estimator if needed and compute the distances
+   * between all the windows of W delay vectors.
+   * @param ts One channel per column
+   */
+  void Run(const Eigen::MatrixXd& ts) throw(std::runtime_error)
+  {
+    if (ts.cols() == 1) {
+      series_ = ts.col(0);
+      embedding_.resize(0, 0);
+    } else {
+      series_.resize(0);
+      if (m_.size() == 1) {
+        rlfd::delay::DelayEmbedding::Embed(ts, Eigen::VectorXi::Constant(ts.cols(), m_[0]),
+                                           Eigen::VectorXi::Constant(ts.cols(), lag_[0]), embedding_);
+      } else {
+        rlfd::delay::DelayEmbedding::Embed(ts, m_, lag_, embedding_);
+      }
+    }
+
+    auto embedding = GetEmbedding();
+    if (embedding.rows() <= W_) {
+      throw std::runtime_error("The time series is too short for the window size");
+    }
+    if (embeddingSpill_ != "") {
+      rlfd::utils::Export(embeddingSpill_, Eigen::MatrixXd(embedding));
+    }
+
+    rlfd::stats::GaussianDensityEstimator kde(sigma_, embedding.cols());
+    kde.SetBackend(backend_);
+    kde.SetTolerance(tolerance_);
+    kde.SetSummation(summation_);
+    if (sigma_ <= 0) {
+      kde.Calibrate(embedding);
+    }
+    bandwidth_ = kde.GetSigma();
+
+    const int N = embedding.rows() - W_;
+    tiled_ = tiledStore_ != "";
+    if (tiled_) {
+      distances_.resize(0, 0);
+      store_.Create(tiledStore_, N, rlfd::stats::GaussianDensityEstimator::GetTileSize());
+      kde.DistanceTiles(embedding, W_, [&](int s0, int t0, const Eigen::MatrixXd& tile) {
+        store_.WriteTile(s0, t0, tile);
+      }, threads_);
+    } else {
+      distances_.setZero(N, N);
+      kde.DistanceMatrix(embedding, W_, distances_, threads_);
+      if (distanceSpill_ != "") {
+        rlfd::utils::Export(distanceSpill_, distances_);
+      }
+    }
+  }
+
+  /**
+   * C-Segmentation of the distances computed by Run.
+   * @param C The regularization constant
+   * @param states Output state of the optimal path at each time
+   * @return The cost of the optimal path
+   */
+  double CSegment(double C, Eigen::VectorXi& states)
+  {
+    if (tiled_) {
+      return CSegmentation(store_, C, states);
+    }
+    return CSegmentation(distances_, C, states);
+  }
+
+  /**
+   * N-Segmentation of the distances computed by Run.
+   * @param N The maximal number of segments
+   * @param costs Output cost of the optimal path with n+1 segments
+   * @param states Output states of these paths, one per row
+   */
+  void NSegment(unsigned N, Eigen::VectorXd& costs, Eigen::MatrixXi& states)
+  {
+    if (tiled_) {
+      NSegmentation(store_, N, costs, states);
+    } else {
+      NSegmentation(distances_, N, costs, states);
+    }
+  }
+
+  /**
+   * @return The delay vectors of the time series given to Run
+   */
+  rlfd::stats::GaussianDensityEstimator::Samples GetEmbedding()
+  {
+    if (series_.size() > 0) {
+      return rlfd::delay::DelayEmbedding::EmbedView(series_, m_[0], lag_[0]);
+    }
+    return embedding_;
+  }
+
+  /**
+   * @return The distances strictly below the diagonal, or an empty matrix
+   * with a tiled store
+   */
+  const Eigen::MatrixXd& GetDistances() { return distances_; }
+
+ private:
+  Eigen::VectorXi m_;
+  Eigen::VectorXi lag_;
+  int W_;
+  double sigma_;
+  double bandwidth_;
+  unsigned threads_;
+  rlfd::stats::GaussianDensityEstimator::Backend backend_;
+  double tolerance_;
+  rlfd::stats::KernelSummation summation_;
+
+  std::string embeddingSpill_;
+  std::string distanceSpill_;
+  std::string tiledStore_;
+
+  // A scalar series, read through a view, or the multichannel delay vectors
+  Eigen::VectorXd series_;
+  Eigen::MatrixXd embedding_;
+  Eigen::MatrixXd distances_;
+  rlfd::utils::DistanceStore store_;
+  bool tiled_;
+};
+
+} // namespace segment
+} // namespace rlfd
+
+#endif // __PIPELINE_HH__
@@ -20,9 +20,18 @@
 #ifndef __GAUSSIANDENSITYESTIMATOR_HH__
 #define __GAUSSIANDENSITYESTIMATOR_HH__
 
+#include <rlfd/utils/KdTree.hh>
+#include <rlfd/utils/ParallelFor.hh>
+#include <rlfd/stats/GaussianKernel.hh>
+#include <rlfd/stats/WindowCache.hh>
+#include <rlfd/stats/KernelSummation.hh>
+
 #include <Eigen/Core>
-#include <flann/flann.hpp>
+#include <vector>
+#include <memory>
 #include <numeric>
+#include <utility>
+#include <algorithm>
 
 namespace rlfd {
 namespace stats {
@@ -37,124 +46,226 @@ class GaussianDensityEstimator
    */
   GaussianDensityEstimator(double sigma = 1.0, int d = 4) : d_(d), sigma_(sigma) {};
 
+  /**
+   * Row vectors, held either by a plain matrix or by a strided view such as
+   * DelayEmbedding::View, which are both read in place.
+   */
+  typedef Eigen::Ref<const Eigen::MatrixXd> Samples;
+
   double GetSigma() { return sigma_; }
 
   double GetDimensionality() { return d_; }
 
   static constexpr double Pi() { return std::acos(-1.0); }
 
+  /**
+   * @return The factor k applied to the squared distances in the kernel
+   * terms exp(k*||x - y||^2) of the integrated squared error
+   */
+  double GetKernelFactor() { return -1.0/(4.0*std::pow(sigma_, 2.0)); }
+
+  /**
+   * @return The factor applied to the sums of kernel terms between windows of
+   * W samples to obtain their distance
+   */
+  double GetNormalization(int W)
+  {
+    return 1.0/(std::pow(W, 2)*std::pow(4.0*std::pow(sigma_, 2.0)*Pi(), ((double) d_)/2.0));
+  }
+
+  /**
+   * Ways of computing the kernel sums between windows in DistanceMatrix
+   */
+  enum class Backend {
+    // Slide the window sums along the diagonals of the matrix
+    Incremental,
+    // Compute all the pairwise squared distances of a tile with matrix products
+    Gemm,
+    // Only sum the kernel terms within a radius, found by a radius search over
+    // each tile, so that the neglected ones change a distance by at most the
+    // tolerance
+    Truncated,
+    // Sum the kernel terms of every pair of windows separately, with the
+    // kernel summation method
+    Pairwise
+  };
+
+  void SetBackend(Backend backend) { backend_ = backend; }
+
+  Backend GetBackend() { return backend_; }
+
+  /**
+   * Bound on the absolute error that the Truncated backend may introduce in
+   * each distance by neglecting the kernel terms of distant sample pairs.
+   */
+  void SetTolerance(double tolerance) { tolerance_ = tolerance; }
+
+  double GetTolerance() { return tolerance_; }
+
+  /**
+   * @return The fraction of the sample pairs covered by the tiles whose kernel
+   * term was evaluated by the last call to DistanceMatrix with the Truncated
+   * backend.
+   */
+  double GetPruningRatio() { return pruningRatio_; }
+
+  /**
+   * How the cross sums between two windows are computed by operator() and by
+   * the Pairwise backend. The self sums cached with the previous method are
+   * dropped.
+   */
+  void SetSummation(const KernelSummation& summation)
+  {
+    summation_ = summation;
+    cache_.Clear();
+  }
+
+  const KernelSummation& GetSummation() { return summation_; }
+
+  /**
+   * @return The number of windows along each side of the tiles handed out by
+   * DistanceTiles
+   */
+  static int GetTileSize() { return TileSize; }
+
   /**
    * Compute the distance matrix for overlapping windows spread appart by one
    * sample.
+   * @param distancesOut Receives the distances strictly below the diagonal
+   * @param nthreads The number of threads. 0 means one per core.
    */
-  void DistanceMatrix(const Eigen::MatrixXd& ts, int W, Eigen::MatrixXd& distancesOut)
+  void DistanceMatrix(const Samples& ts, int W, Eigen::MatrixXd& distancesOut, unsigned nthreads = 1)
   {
-    double foursigma2 = 4.0*std::pow(sigma_, 2.0);
-    double k = -1.0/foursigma2;
-    double normalization = (1.0/(std::pow(W, 2)*std::pow(foursigma2 * Pi(), ((double) d_)/2.0)));
-
-    const double* dataPtr = ts.data();
-
-    // Pre-compute the self-sums
-    Eigen::VectorXd selfSums(ts.rows()-W);
-    for (int s = 0; s < ts.rows()-W; s++) {
-      double sum = 0.0;
-      const double* xPtr = dataPtr + s;
-      //auto xblock = ts.block(s, 0, W, d_);
-
-      for (int w = 0; w < W; w++) {
-        for (int v = 0; v < W; v++) {
-          double squaredNorm = 0.0;
-          for (int j = 0; j < d_; j++) {
-            double norm = xPtr[w + j*W] - xPtr[v + j*W];
-            squaredNorm += norm*norm;
-            //std::cout << "xblock(" << w << ", " << j << ")" << xblock(w, j) << " vs " << xPtr[w + j*W] << std::endl;
-          }
-          //std::cout << "Squared norm" << squaredNorm << std::endl;
-          //std::cout << (xblock.row(w) - xblock.row(v)).squaredNorm() << std::endl;
-
-          sum += std::exp(k*squaredNorm);
+    DistanceTiles(ts, W, [&](int s0, int t0, const Eigen::MatrixXd& tile) {
+      for (int j = 0; j < tile.cols(); j++) {
+        for (int i = std::max(t0 + j + 1 - s0, 0); i < tile.rows(); i++) {
+          distancesOut(s0 + i, t0 + j) = tile(i, j);
         }
       }
-
-      selfSums[s] = sum;
-    }
-    //std::cout << selfSums << std::endl;
-
-    // Compute for each sample
-    for (int s = 1; s < ts.rows()-W; s++) {
-      const double* xprimePtr = dataPtr + W*(s+1);
-
-      // Up to diagonal
-      for (int t = 0; t < s; t++) {
-        const double* xPtr = xprimePtr + 1;
-
-        // Integrated Square Error computation
-        double crossSum = 0.0;
-        for (int w = 0; w < W; w++) {
-          for (int v = 0; v < W; v++) {
-
-            // Squared norm
-            double squaredNormCross = 0.0;
-            for (int j = 0; j < d_; j++) {
-              double norm = (xprimePtr + w + j*W) - (xPtr + v + j*W);
-              squaredNormCross += norm*norm;
-            }
-
-            crossSum += -2.0*std::exp(k*squaredNormCross);
-          }
-        }
-
-        distancesOut(s, t) = normalization*(selfSums[s] + crossSum + selfSums[t]);
-      }
-    }
-
+    }, nthreads);
   }
 
   /**
-   * Estimate the pdf only in a fixed-size window
-   * @param X Row vectors to be estimated.
-   * @param sigma Found by EstimateSigma
-   * @param d The knn parameter in EstimateSigma
-   * @param W The window size
+   * Compute the distance matrix one tile at a time, without holding it in
+   * memory.
    *
+   * The lower triangle is split into square tiles of TileSize windows which
+   * are scheduled over a pool of threads. The cross sums of a tile are then
+   * computed by the selected backend.
+   * @param sink Called as sink(s0, t0, tile) for every tile, where tile(i, j)
+   * is the distance between windows s0+i and t0+j. Entries on and above the
+   * diagonal are zero. Calls may come concurrently from several threads.
+   * @param nthreads The number of threads. 0 means one per core.
    */
-  template<typename Derived>
-double operator()(const Eigen::Block<Derived>& X, const Eigen::Block<Derived>& Xprime)
-{
-  int W = X.rows();
-  double foursigma2 = 4.0*std::pow(sigma_, 2.0);
-  double normalization = 1.0/(std::pow(W, 2)*std::pow(foursigma2 * Pi(), ((double) d_)/2.0));
-  int k = -1.0/foursigma2;
+  template<typename TileSink>
+  void DistanceTiles(const Samples& ts, int W, TileSink sink, unsigned nthreads = 1)
+  {
+    double k = GetKernelFactor();
+    double normalization = GetNormalization(W);
 
+    const int N = ts.rows()-W;
+    if (N <= 0) {
+      return;
+    }
 
-  const double* ptrX = X.data();
-  const double* ptrXprime = Xprime.data();
+    // Pre-compute the self-sums along the main diagonal
+    Eigen::VectorXd selfSums(N);
+    selfSums[0] = WindowSum(ts, 0, 0, W, k);
+    for (int s = 1; s < N; s++) {
+      selfSums[s] = SlideWindowSum(ts, s-1, s-1, W, k, selfSums[s-1]);
+    }
 
-  double sum = 0.0;
-  for (int w = 0; w < W; w++) {
-    for (int v = 0; v < W; v++) {
+    // Centering the samples limits the cancellation in the expanded squared
+    // distances of the GEMM backend
+    Eigen::MatrixXd centered;
+    if (backend_ == Backend::Gemm) {
+      centered = ts.rowwise() - ts.colwise().mean();
+    }
 
-      double squaredNormSelf = 0.0;
-      double squaredNormCross = 0.0;
-      double squaredNormPast = 0.0;
-      double norm = 0.0;
-      for (int j = 0; j < d_; j++) {
-        norm = (ptrXprime + w + j*W) - (ptrXprime + v + j*W);
-        squaredNormSelf += norm*norm;
+    // Enumerate the tiles of the lower triangle, diagonal included
+    std::vector<std::pair<int, int>> tiles;
+    for (int s0 = 0; s0 < N; s0 += TileSize) {
+      for (int t0 = 0; t0 <= s0; t0 += TileSize) {
+        tiles.push_back(std::make_pair(s0, t0));
+      }
+    }
 
-        norm = (ptrXprime + w + j*W) - (ptrX + v + j*W);
-        squaredNormCross += norm*norm;
+    // One tree over the samples of each column of tiles, and the number of
+    // sample pairs within the radius for each tile
+    const double squaredRadius = TruncationRadius(W, k, normalization);
+    std::vector<std::unique_ptr<rlfd::utils::KdTree>> columnTrees;
+    std::vector<size_t> retained(tiles.size(), 0);
+    std::vector<size_t> pairs(tiles.size(), 0);
+    if (backend_ == Backend::Truncated) {
+      for (int t0 = 0; t0 < N; t0 += TileSize) {
+        const int cols = std::min(t0 + TileSize, N) - t0 + W - 1;
+        columnTrees.emplace_back(new rlfd::utils::KdTree(ts.block(t0, 0, cols, d_)));
+      }
+    }
 
-        norm = (ptrX + w + j*W) - (ptrX + v + j*W);
-        squaredNormPast += norm*norm;
+    rlfd::utils::ParallelFor(tiles.size(), nthreads, [&](size_t i) {
+      int s0 = tiles[i].first;
+      int t0 = tiles[i].second;
+      int s1 = std::min(s0 + TileSize, N);
+      int t1 = std::min(t0 + TileSize, N);
+
+      Eigen::MatrixXd tile = Eigen::MatrixXd::Zero(s1 - s0, t1 - t0);
+      auto store = [&](int s, int t, double crossSum) {
+        tile(s - s0, t - t0) = normalization*(selfSums[s] - 2.0*crossSum + selfSums[t]);
+      };
+
+      if (backend_ == Backend::Gemm) {
+        GemmTile(centered, W, k, s0, s1, t0, t1, store);
+      } else if (backend_ == Backend::Truncated) {
+        pairs[i] = ((size_t) (s1 - s0 + W - 1))*(t1 - t0 + W - 1);
+        retained[i] = TruncatedTile(ts, *columnTrees[t0/TileSize], squaredRadius, W, k,
+                                    s0, s1, t0, t1, store);
+      } else if (backend_ == Backend::Pairwise) {
+        PairwiseTile(ts, W, k, s0, s1, t0, t1, store);
+      } else {
+        IncrementalTile(ts, W, k, s0, s1, t0, t1, store);
       }
-      sum += std::exp(k*squaredNormSelf) - 2.0*std::exp(k*squaredNormCross) + std::exp(k*squaredNormPast);
 
+      sink(s0, t0, tile);
+    });
+
+    if (backend_ == Backend::Truncated) {
+      pruningRatio_ = ((double) std::accumulate(retained.begin(), retained.end(), (size_t) 0))/
+          std::accumulate(pairs.begin(), pairs.end(), (size_t) 0);
     }
   }
 
-  return normalization*sum;
+  /**
+   * The self sums and packed samples of the windows compared by operator()
+   */
+  WindowCache& GetWindowCache() { return cache_; }
+
+  /**
+   * Distance between the densities estimated in two windows of W samples.
+   * Their self sums come from the window cache, keyed by the first row of the
+   * blocks, and only the cross sum is computed.
+   * @param X W row vectors of a column-major matrix
+   * @param Xprime W row vectors of the same matrix
+   */
+  template<typename Derived>
+double operator()(const Eigen::Block<Derived>& X, const Eigen::Block<Derived>& Xprime)
+{
+  const double k = GetKernelFactor();
+  auto selfSum = [&](const Eigen::MatrixXd& window) {
+    return PackedSum(window, window, k);
+  };
+
+  std::shared_ptr<const WindowCache::Window> x = cache_.Get(X.startRow(), X, selfSum);
+  std::shared_ptr<const WindowCache::Window> xprime = cache_.Get(Xprime.startRow(), Xprime, selfSum);
+  return Distance(*x, *xprime, k);
+}
+
+/**
+ * Distance between the windows of W samples starting at s and t in ts.
+ */
+double operator()(const Samples& ts, int s, int t, int W)
+{
+  return (*this)(ts.block(s, 0, W, ts.cols()), ts.block(t, 0, W, ts.cols()));
 }
 
 /**
@@ -163,28 +274,24 @@ double operator()(const Eigen::Block<Derived>& X, const Eigen::Block<Derived>& X
  * @param X Row vectors to be estimated.
  * @param knn The number of nearest neighbors over which to take average
  * distance
+ * @param index A tree over the rows of X, whose own points are searched
+ * rather than copied again as queries
  * @return The average distance to the knn in the sample X
  */
-static double EstimateSigma(const Eigen::MatrixXd& X, int knn, flann::Index<flann::L2<double>>& index)
+static double EstimateSigma(const Samples& X, int knn, rlfd::utils::KdTree& index)
 {
   // Compute the knn for all of the data points
   knn += 1;
-  flann::Matrix<int> indices(new int[X.rows()*knn], X.rows(), knn);
-  flann::Matrix<double> dists(new double[X.rows()*knn], X.rows(), knn);
-  flann::Matrix<double> query(new double[X.rows()*X.cols()], X.rows(), X.cols());
-  for (int i = 0; i < X.rows(); i++) {
-    for (int j = 0; j < X.cols(); j++) {
-      query[i][j] = X(i, j);
-    }
-  }
-  index.knnSearch(query, indices, dists, knn, flann::SearchParams(128));
+  rlfd::utils::KdTree::Indices indices;
+  rlfd::utils::KdTree::Distances dists;
+  index.Knn(knn, indices, dists);
 
   // Compute the average distance to the knn of each point
   Eigen::VectorXd avg_dists(X.rows());
   for (int i = 0; i < X.rows(); i++) {
     double avg_dist = 0.0;
     for (int k = 1; k < knn; k++) {
-      avg_dist += std::sqrt(dists[i][k]);
+      avg_dist += std::sqrt(dists(i, k));
     }
     avg_dists(i) = avg_dist/((double) (knn - 1));
   }
@@ -195,28 +302,224 @@ static double EstimateSigma(const Eigen::MatrixXd& X, int knn, flann::Index<flan
 
 /**
  * Set parameters of this KDE instance using the EstimateSigma method.
- * An index is created automatically for this purpose.
+ * An index is created automatically for this purpose. The cached self sums,
+ * computed with the previous bandwidth, are dropped.
  * @param sample Sample points from which to infer the parameters
  */
-void Calibrate(const Eigen::MatrixXd& sample)
+void Calibrate(const Samples& sample)
 {
-  // TODO get rid of this copying
-  flann::Matrix<double> input(new double[sample.rows()*sample.cols()], sample.rows(), sample.cols());
-  for (int i = 0; i  < sample.rows(); i++) {
-    for (int j = 0; j < sample.cols(); j++) {
-      input[i][j] = sample(i, j);
-    }
-  }
-
-  flann::Index<flann::L2<double> > index(input, flann::KDTreeSingleIndexParams());
-  index.buildIndex();
+  rlfd::utils::KdTree index(sample);
 
   sigma_ = EstimateSigma(sample, sample.cols(), index);
   d_ = sample.cols();
+  cache_.Clear();
 }
 
 private:
 
+/**
+ * Sum of the kernel terms between sample i and the n consecutive samples
+ * starting at j.
+ */
+double KernelSum(const Samples& ts, int i, int j, int n, double k) const
+{
+  const double* dataPtr = ts.data();
+  const int stride = ts.outerStride();
+  return GaussianKernelSum(dataPtr + i, stride, dataPtr + j, stride, n, d_, k);
+}
+
+/**
+ * Sum of the kernel terms between all pairs of samples of the windows of
+ * size W starting at s and t.
+ */
+double WindowSum(const Samples& ts, int s, int t, int W, double k) const
+{
+  double sum = 0.0;
+  for (int w = 0; w < W; w++) {
+    sum += KernelSum(ts, s + w, t, W, k);
+  }
+  return sum;
+}
+
+/**
+ * Given the window sum for (s, t), compute the one for (s+1, t+1) by
+ * removing the kernel terms of row s and column t, and adding those of row
+ * s+W and column t+W.
+ */
+double SlideWindowSum(const Samples& ts, int s, int t, int W, double k, double sum) const
+{
+  sum -= KernelSum(ts, s, t, W, k) + KernelSum(ts, t, s + 1, W - 1, k);
+  sum += KernelSum(ts, s + W, t + 1, W, k) + KernelSum(ts, t + W, s + 1, W - 1, k);
+  return sum;
+}
+
+/**
+ * Compute the cross sums of the tile [s0, s1) x [t0, t1) below the main
+ * diagonal, incrementally along each diagonal: windows (s+1, t+1) share W-1
+ * samples with (s, t), so going from one cell to the next only requires
+ * adding and removing one row and one column of kernel terms. This brings the
+ * cost of a cell from O(W^2 d) down to O(W d). Each diagonal is anchored by
+ * one exact window sum.
+ * @param visit Called with (s, t, crossSum) for each cell
+ */
+template<typename Visitor>
+void IncrementalTile(const Samples& ts, int W, double k, int s0, int s1, int t0, int t1, Visitor visit) const
+{
+  for (int delta = std::max(s0 - (t1 - 1), 1); delta < s1 - t0; delta++) {
+    int t = std::max(t0, s0 - delta);
+    double crossSum = WindowSum(ts, t + delta, t, W, k);
+    visit(t + delta, t, crossSum);
+
+    for (t = t + 1; t < t1 && t + delta < s1; t++) {
+      int s = t + delta;
+      crossSum = SlideWindowSum(ts, s-1, t-1, W, k, crossSum);
+      visit(s, t, crossSum);
+    }
+  }
+}
+
+/**
+ * Compute the cross sums of the tile [s0, s1) x [t0, t1) below the main
+ * diagonal from the kernel matrix between all the samples it covers. The
+ * squared distances are expanded as ||x||^2 + ||y||^2 - 2 x.y so that the bulk
+ * of the work is a single matrix product, and the window sums are then read
+ * off a summed-area table of the kernel matrix in O(1) per cell.
+ * @param visit Called with (s, t, crossSum) for each cell
+ */
+template<typename Visitor>
+void GemmTile(const Samples& ts, int W, double k, int s0, int s1, int t0, int t1, Visitor visit) const
+{
+  const int rows = s1 - s0 + W - 1;
+  const int cols = t1 - t0 + W - 1;
+  auto X = ts.block(s0, 0, rows, d_);
+  auto Y = ts.block(t0, 0, cols, d_);
+
+  Eigen::MatrixXd squaredNorms = -2.0*(X*Y.transpose());
+  squaredNorms.colwise() += X.rowwise().squaredNorm();
+  squaredNorms.rowwise() += Y.rowwise().squaredNorm().transpose();
+
+  Eigen::MatrixXd sums = Eigen::MatrixXd::Zero(rows + 1, cols + 1);
+  sums.bottomRightCorner(rows, cols) = (k*squaredNorms.array().max(0.0)).exp().matrix();
+  VisitSummedArea(sums, W, s0, s1, t0, t1, visit);
+}
+
+/**
+ * Compute the cross sums of the tile [s0, s1) x [t0, t1) below the main
+ * diagonal one pair of windows at a time, with the kernel summation method.
+ * Each window is packed once per tile.
+ * @param visit Called with (s, t, crossSum) for each cell
+ */
+template<typename Visitor>
+void PairwiseTile(const Samples& ts, int W, double k, int s0, int s1, int t0, int t1, Visitor visit) const
+{
+  std::vector<Eigen::MatrixXd> columns(t1 - t0);
+  for (int t = t0; t < t1; t++) {
+    columns[t - t0] = ts.block(t, 0, W, d_);
+  }
+
+  for (int s = s0; s < s1; s++) {
+    Eigen::MatrixXd window = ts.block(s, 0, W, d_);
+    for (int t = t0; t < std::min(t1, s); t++) {
+      visit(s, t, summation_.Sum(window, columns[t - t0], k));
+    }
+  }
+}
+
+/**
+ * Compute the cross sums of the tile [s0, s1) x [t0, t1) below the main
+ * diagonal from the kernel terms of the sample pairs within the radius only.
+ * The samples of the tile rows are searched in the tree over the samples of
+ * its columns, so that only the neighbors of this tile are held at once.
+ * @param columns The tree over the W-1+t1-t0 samples starting at t0
+ * @param visit Called with (s, t, crossSum) for each cell
+ * @return The number of sample pairs within the radius
+ */
+template<typename Visitor>
+size_t TruncatedTile(const Samples& ts, rlfd::utils::KdTree& columns, double squaredRadius, int W, double k,
+                     int s0, int s1, int t0, int t1, Visitor visit) const
+{
+  const int rows = s1 - s0 + W - 1;
+  const int cols = t1 - t0 + W - 1;
+
+  // flann works with squared distances under L2
+  std::vector<std::vector<int>> indices;
+  std::vector<std::vector<double>> dists;
+  columns.Radius(ts.block(s0, 0, rows, d_), squaredRadius, indices, dists);
+
+  size_t retained = 0;
+  Eigen::MatrixXd sums = Eigen::MatrixXd::Zero(rows + 1, cols + 1);
+  for (int i = 0; i < rows; i++) {
+    for (size_t n = 0; n < indices[i].size(); n++) {
+      sums(i + 1, indices[i][n] + 1) = std::exp(k*dists[i][n]);
+    }
+    retained += indices[i].size();
+  }
+
+  VisitSummedArea(sums, W, s0, s1, t0, t1, visit);
+  return retained;
+}
+
+/**
+ * The squared radius beyond which the Truncated backend neglects the kernel
+ * terms. A distance is normalization*(selfSum_s + selfSum_t - 2 crossSum), and
+ * only the W^2 terms of the cross sum are truncated, each by less than
+ * exp(k*squaredRadius). Its error is thus at most
+ * 2*normalization*W^2*exp(k*squaredRadius), which the radius keeps under the
+ * tolerance.
+ */
+double TruncationRadius(int W, double k, double normalization) const
+{
+  double bound = tolerance_/(2.0*normalization*W*W);
+  return bound >= 1.0 ? 0.0 : std::log(bound)/k;
+}
+
+/**
+ * Turn the kernel terms held in sums(1.., 1..) into a summed-area table, where
+ * sums(i, j) is the sum of the terms of rows < i and columns < j, and report
+ * the window sums of the tile [s0, s1) x [t0, t1) in O(1) per cell.
+ */
+template<typename Visitor>
+static void VisitSummedArea(Eigen::MatrixXd& sums, int W, int s0, int s1, int t0, int t1, Visitor visit)
+{
+  for (int j = 1; j < sums.cols(); j++) {
+    for (int i = 1; i < sums.rows(); i++) {
+      sums(i, j) += sums(i - 1, j) + sums(i, j - 1) - sums(i - 1, j - 1);
+    }
+  }
+
+  for (int t = t0; t < t1; t++) {
+    int j = t - t0;
+    for (int s = std::max(s0, t + 1); s < s1; s++) {
+      int i = s - s0;
+      visit(s, t, sums(i + W, j + W) - sums(i, j + W) - sums(i + W, j) + sums(i, j));
+    }
+  }
+}
+
+/**
+ * Distance between two cached windows, from their packed samples.
+ */
+double Distance(const WindowCache::Window& x, const WindowCache::Window& xprime, double k)
+{
+  return GetNormalization(x.data.rows())*(x.selfSum + xprime.selfSum - 2.0*PackedSum(x.data, xprime.data, k));
+}
+
+/**
+ * Sum of the kernel terms between all pairs of samples of two packed windows.
+ */
+double PackedSum(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, double k) const
+{
+  return summation_.Sum(X, Y, k);
+}
+
+static const int TileSize = 128;
+
+Backend backend_ = Backend::Incremental;
+double tolerance_ = 1e-12;
+double pruningRatio_ = 1.0;
+WindowCache cache_;
+KernelSummation summation_;
+
 int d_;
 double sigma_;
 
@@ -0,0 +1,232 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __GAUSSIANKERNEL_HH__
+#define __GAUSSIANKERNEL_HH__
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RLFD_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace rlfd {
+namespace stats {
+
+/**
+ * Signature of the kernel sum implementations.
+ * @param x The query point, with its coordinates spaced by xstride
+ * @param y The first of n consecutive points stored column-major, with
+ * coordinate j of point v at y[v + j*ystride]
+ * @param d The dimensionality of the points
+ * @param k The (negative) factor applied to the squared distances
+ * @return The sum over v of exp(k*||x - y_v||^2)
+ */
+typedef double (*KernelSumFunction)(const double* x, int xstride, const double* y, int ystride, int n, int d, double k);
+
+namespace detail {
+
+/**
+ * Arguments below this value underflow the double precision exponential.
+ */
+static constexpr double ExpUnderflow = -708.0;
+
+inline double KernelSumScalar(const double* x, int xstride, const double* y, int ystride, int n, int d, double k)
+{
+  double sum = 0.0;
+  for (int v = 0; v < n; v++) {
+    double squaredNorm = 0.0;
+    for (int j = 0; j < d; j++) {
+      double norm = x[j*xstride] - y[v + j*ystride];
+      squaredNorm += norm*norm;
+    }
+    sum += std::exp(k*squaredNorm);
+  }
+  return sum;
+}
+
+#ifdef RLFD_KERNEL_X86
+
+/**
+ * Vectorized exponential for arguments in [ExpUnderflow, 0]. The argument is
+ * reduced to r in [-ln(2)/2, ln(2)/2] with x = n ln(2) + r, and exp(r) is
+ * evaluated by its Taylor polynomial of degree 11, for a relative error
+ * below 1e-13. Arguments below ExpUnderflow are flushed to zero.
+ */
+__attribute__((target("avx2,fma")))
+inline __m256d ExpAvx2(__m256d x)
+{
+  const __m256d underflow = _mm256_set1_pd(ExpUnderflow);
+  __m256d keep = _mm256_cmp_pd(x, underflow, _CMP_GE_OQ);
+  x = _mm256_max_pd(x, underflow);
+
+  __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+                              _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93145751953125e-1), x);
+  r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.42860682030941723212e-6), r);
+
+  __m256d p = _mm256_set1_pd(1.0/39916800.0);
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0/3628800.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0/362880.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0/40320.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0/5040.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0/720.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0/120.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0/24.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0/6.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(0.5));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+  p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+
+  // Scale by 2^n: adding 1.5*2^52 moves n into the low bits of the mantissa
+  const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+  __m256i bits = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, magic)), _mm256_castpd_si256(magic));
+  bits = _mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+  p = _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+
+  return _mm256_and_pd(p, keep);
+}
+
+__attribute__((target("avx2,fma")))
+inline double KernelSumAvx2(const double* x, int xstride, const double* y, int ystride, int n, int d, double k)
+{
+  const __m256d kk = _mm256_set1_pd(k);
+  __m256d acc = _mm256_setzero_pd();
+
+  int v = 0;
+  for (; v + 4 <= n; v += 4) {
+    __m256d squaredNorm = _mm256_setzero_pd();
+    for (int j = 0; j < d; j++) {
+      __m256d norm = _mm256_sub_pd(_mm256_loadu_pd(y + v + j*ystride), _mm256_set1_pd(x[j*xstride]));
+      squaredNorm = _mm256_fmadd_pd(norm, norm, squaredNorm);
+    }
+    acc = _mm256_add_pd(acc, ExpAvx2(_mm256_mul_pd(kk, squaredNorm)));
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+  return sum + KernelSumScalar(x, xstride, y + v, ystride, n - v, d, k);
+}
+
+// GCC flags the undefined passthrough operands of its own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/**
+ * AVX-512 counterpart of ExpAvx2, relying on vscalefpd for the 2^n scaling.
+ */
+__attribute__((target("avx512f")))
+inline __m512d ExpAvx512(__m512d x)
+{
+  const __m512d underflow = _mm512_set1_pd(ExpUnderflow);
+  __mmask8 keep = _mm512_cmp_pd_mask(x, underflow, _CMP_GE_OQ);
+  x = _mm512_max_pd(x, underflow);
+
+  __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634)),
+                                   _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(6.93145751953125e-1), x);
+  r = _mm512_fnmadd_pd(n, _mm512_set1_pd(1.42860682030941723212e-6), r);
+
+  __m512d p = _mm512_set1_pd(1.0/39916800.0);
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0/3628800.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0/362880.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0/40320.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0/5040.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0/720.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0/120.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0/24.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0/6.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(0.5));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0));
+  p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.0));
+
+  return _mm512_maskz_scalef_pd(keep, p, n);
+}
+
+__attribute__((target("avx512f")))
+inline double KernelSumAvx512(const double* x, int xstride, const double* y, int ystride, int n, int d, double k)
+{
+  const __m512d kk = _mm512_set1_pd(k);
+  __m512d acc = _mm512_setzero_pd();
+
+  int v = 0;
+  for (; v + 8 <= n; v += 8) {
+    __m512d squaredNorm = _mm512_setzero_pd();
+    for (int j = 0; j < d; j++) {
+      __m512d norm = _mm512_sub_pd(_mm512_loadu_pd(y + v + j*ystride), _mm512_set1_pd(x[j*xstride]));
+      squaredNorm = _mm512_fmadd_pd(norm, norm, squaredNorm);
+    }
+    acc = _mm512_add_pd(acc, ExpAvx512(_mm512_mul_pd(kk, squaredNorm)));
+  }
+
+  // Remainder with a masked vector instead of falling back to scalar code
+  if (v < n) {
+    __mmask8 mask = (__mmask8) ((1u << (n - v)) - 1u);
+    __m512d squaredNorm = _mm512_setzero_pd();
+    for (int j = 0; j < d; j++) {
+      __m512d norm = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, y + v + j*ystride), _mm512_set1_pd(x[j*xstride]));
+      squaredNorm = _mm512_fmadd_pd(norm, norm, squaredNorm);
+    }
+    acc = _mm512_mask_add_pd(acc, mask, acc, ExpAvx512(_mm512_mul_pd(kk, squaredNorm)));
+  }
+
+  return _mm512_reduce_add_pd(acc);
+}
+
+#pragma GCC diagnostic pop
+
+#endif // RLFD_KERNEL_X86
+
+/**
+ * Pick the widest implementation supported by the running processor.
+ */
+inline KernelSumFunction SelectKernelSum()
+{
+#ifdef RLFD_KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return &KernelSumAvx512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return &KernelSumAvx2;
+  }
+#endif
+  return &KernelSumScalar;
+}
+
+} // namespace detail
+
+/**
+ * Sum the Gaussian kernel terms between a point and n consecutive points of
+ * a column-major matrix. The instruction set is chosen at runtime, once.
+ * @see KernelSumFunction
+ */
+inline double GaussianKernelSum(const double* x, int xstride, const double* y, int ystride, int n, int d, double k)
+{
+  static const KernelSumFunction impl = detail::SelectKernelSum();
+  return impl(x, xstride, y, ystride, n, d, k);
+}
+
+} // namespace stats
+} // namespace rlfd
+#endif // __GAUSSIANKERNEL_HH__
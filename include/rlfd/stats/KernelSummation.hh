@@ -0,0 +1,476 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __KERNELSUMMATION_HH__
+#define __KERNELSUMMATION_HH__
+
+#include <rlfd/stats/GaussianKernel.hh>
+
+#include <Eigen/Core>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+
+namespace rlfd {
+namespace stats {
+
+/**
+ * Sums of Gaussian kernel terms exp(k*||x_i - y_j||^2) over all the pairs of
+ * rows of two matrices, computed exactly or to a given tolerance.
+ *
+ * The approximate methods guarantee an absolute error of at most the
+ * tolerance per kernel term, that is tolerance*|X|*|Y| on the sum.
+ *
+ * The number of terms of the IFGT expansions grows as C(p+d, d) with the
+ * dimensionality d and the degree p that the tolerance requires, and every
+ * target is checked against every cluster. The clusters are sized to
+ * minimize that cost, and when even the cheapest expansions are estimated to
+ * cost more than the kernel terms themselves, the sum is computed exactly.
+ * With a tolerance of 1e-6 and the bandwidth of Calibrate, this is the case
+ * for every window of up to several thousand samples, whatever the
+ * dimensionality: the expansions only pay off when the samples span a few
+ * bandwidths at most, in windows of thousands of samples. The search for the
+ * clusters then adds up to a fifth to the exact sum.
+ */
+class KernelSummation
+{
+ public:
+  enum class Method {
+    // Every kernel term, vectorized
+    Exact,
+    // Improved Fast Gauss Transform: truncated Taylor expansions of the
+    // kernel around the centers of clusters of Y
+    Ifgt,
+    // Traverse kd-trees over X and Y together, approximating the pairs of
+    // nodes whose kernel terms are all within the tolerance of each other
+    DualTree
+  };
+
+  KernelSummation(Method method = Method::Exact, double tolerance = 1e-6) :
+      method_(method), tolerance_(tolerance) {};
+
+  void SetMethod(Method method) { method_ = method; }
+
+  Method GetMethod() const { return method_; }
+
+  void SetTolerance(double tolerance) { tolerance_ = tolerance; }
+
+  double GetTolerance() const { return tolerance_; }
+
+  /**
+   * @param name One of exact, ifgt or dualtree
+   */
+  static Method ParseMethod(const std::string& name) throw(std::runtime_error)
+  {
+    if (name == "exact") {
+      return Method::Exact;
+    } else if (name == "ifgt") {
+      return Method::Ifgt;
+    } else if (name == "dualtree") {
+      return Method::DualTree;
+    }
+    throw std::runtime_error("Unknown kernel summation method " + name);
+  }
+
+  /**
+   * @param X Row vectors
+   * @param Y Row vectors of the same dimensionality
+   * @param k The (negative) factor applied to the squared distances
+   * @return The sum of exp(k*||x_i - y_j||^2) over all rows i and j
+   */
+  double Sum(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, double k) const
+  {
+    if (X.rows() == 0 || Y.rows() == 0) {
+      return 0.0;
+    }
+    switch (method_) {
+      case Method::Ifgt:
+        return IfgtSum(X, Y, k);
+      case Method::DualTree:
+        return DualTreeSum(X, Y, k);
+      default:
+        return ExactSum(X, Y, k);
+    }
+  }
+
+ private:
+  double ExactSum(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, double k) const
+  {
+    double sum = 0.0;
+    for (int i = 0; i < X.rows(); i++) {
+      sum += GaussianKernelSum(X.data() + i, X.rows(), Y.data(), Y.rows(), Y.rows(), Y.cols(), k);
+    }
+    return sum;
+  }
+
+  /**
+   * Balanced kd-tree over a permuted copy of the rows of a matrix, with the
+   * bounding box of every node.
+   */
+  struct KdTree {
+    struct Node {
+      int begin;
+      int end;
+      int left;
+      int right;
+      Eigen::VectorXd lo;
+      Eigen::VectorXd hi;
+    };
+
+    static const int LeafSize = 64;
+
+    Eigen::MatrixXd points;
+    std::vector<Node> nodes;
+
+    KdTree(const Eigen::MatrixXd& X)
+    {
+      std::vector<int> order(X.rows());
+      std::iota(order.begin(), order.end(), 0);
+      Build(X, order, 0, X.rows());
+
+      points.resize(X.rows(), X.cols());
+      for (int i = 0; i < X.rows(); i++) {
+        points.row(i) = X.row(order[i]);
+      }
+    }
+
+    int Build(const Eigen::MatrixXd& X, std::vector<int>& order, int begin, int end)
+    {
+      Node node;
+      node.begin = begin;
+      node.end = end;
+      node.left = node.right = -1;
+      node.lo = X.row(order[begin]).transpose();
+      node.hi = node.lo;
+      for (int i = begin + 1; i < end; i++) {
+        node.lo = node.lo.cwiseMin(X.row(order[i]).transpose());
+        node.hi = node.hi.cwiseMax(X.row(order[i]).transpose());
+      }
+
+      int id = nodes.size();
+      nodes.push_back(node);
+      if (end - begin > LeafSize) {
+        // Split at the median of the widest dimension
+        int dim;
+        (node.hi - node.lo).maxCoeff(&dim);
+        int middle = begin + (end - begin)/2;
+        std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                         [&](int a, int b) { return X(a, dim) < X(b, dim); });
+        int left = Build(X, order, begin, middle);
+        int right = Build(X, order, middle, end);
+        nodes[id].left = left;
+        nodes[id].right = right;
+      }
+      return id;
+    }
+
+    bool IsLeaf(int id) const { return nodes[id].left < 0; }
+
+    int Size(int id) const { return nodes[id].end - nodes[id].begin; }
+  };
+
+  double DualTreeSum(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, double k) const
+  {
+    KdTree A(X);
+    KdTree B(Y);
+    double sum = 0.0;
+    DualTree(A, 0, B, 0, k, sum);
+    return sum;
+  }
+
+  void DualTree(const KdTree& A, int a, const KdTree& B, int b, double k, double& sum) const
+  {
+    const KdTree::Node& na = A.nodes[a];
+    const KdTree::Node& nb = B.nodes[b];
+
+    // Bounds on the distances between the two bounding boxes
+    double minSquared = ((na.lo - nb.hi).cwiseMax(nb.lo - na.hi)).cwiseMax(0.0).squaredNorm();
+    double maxSquared = ((na.hi - nb.lo).cwiseMax(nb.hi - na.lo)).squaredNorm();
+    double kmax = std::exp(k*minSquared);
+    double kmin = std::exp(k*maxSquared);
+
+    // The midpoint is within the tolerance of every kernel term of the pair
+    if (kmax - kmin <= 2.0*tolerance_) {
+      sum += 0.5*(kmax + kmin)*A.Size(a)*B.Size(b);
+      return;
+    }
+
+    if (A.IsLeaf(a) && B.IsLeaf(b)) {
+      const int d = A.points.cols();
+      for (int i = na.begin; i < na.end; i++) {
+        sum += GaussianKernelSum(A.points.data() + i, A.points.rows(), B.points.data() + nb.begin,
+                                 B.points.rows(), B.Size(b), d, k);
+      }
+    } else if (B.IsLeaf(b) || (!A.IsLeaf(a) && A.Size(a) >= B.Size(b))) {
+      DualTree(A, na.left, B, b, k, sum);
+      DualTree(A, na.right, B, b, k, sum);
+    } else {
+      DualTree(A, a, B, nb.left, k, sum);
+      DualTree(A, a, B, nb.right, k, sum);
+    }
+  }
+
+  /**
+   * Exponents of the monomials of degree at most p in d variables, in graded
+   * order, built the same way as the monomials in Monomials.
+   */
+  static void Exponents(int d, int p, std::vector<std::vector<int>>& exponents)
+  {
+    exponents.assign(1, std::vector<int>(d, 0));
+    std::vector<int> heads(d, 0);
+    for (int n = 1; n <= p; n++) {
+      int t = exponents.size();
+      for (int i = 0; i < d; i++) {
+        int head = heads[i];
+        heads[i] = exponents.size();
+        for (int j = head; j < t; j++) {
+          exponents.push_back(exponents[j]);
+          exponents.back()[i]++;
+        }
+      }
+    }
+  }
+
+  /**
+   * Evaluate the monomials v^alpha of degree at most p.
+   */
+  static void Monomials(const double* v, int d, int p, double* out)
+  {
+    int heads[MaxIfgtDimension];
+    std::fill(heads, heads + d, 0);
+    out[0] = 1.0;
+    int k = 1;
+    for (int n = 1; n <= p; n++) {
+      int t = k;
+      for (int i = 0; i < d; i++) {
+        int head = heads[i];
+        heads[i] = k;
+        for (int j = head; j < t; j++) {
+          out[k++] = v[i]*out[j];
+        }
+      }
+    }
+  }
+
+  /**
+   * Smallest degree p whose truncation error stays under the tolerance for
+   * sources within rx of their center, at any target within ry of it. The
+   * remainder of the expansion of exp(2u'v) after degree p is bounded by
+   * (2|u||v|)^(p+1)/(p+1)! exp(2|u||v|), as in C. Yang, R. Duraiswami and
+   * L. Davis, "Efficient Kernel Machines Using the Improved Fast Gauss
+   * Transform", NIPS 2004.
+   * @return -1 if no degree up to maxOrder is enough
+   */
+  int TruncationOrder(double rx, double ry, double h, int maxOrder) const
+  {
+    // The bound at 101 distances rho of the target, in the log domain:
+    // (p+1) log(2 rx rho/h^2) - (rho - rx)^2/h^2 - log((p+1)!)
+    double logs[101];
+    double gaps[101];
+    for (int i = 0; i <= 100; i++) {
+      double rho = ry*i/100.0;
+      double gap = std::max(rho - rx, 0.0);
+      logs[i] = std::log(2.0*rx*rho/(h*h) + 1e-300);
+      gaps[i] = gap*gap/(h*h);
+    }
+
+    const double logTolerance = std::log(tolerance_);
+    for (int p = 0; p <= maxOrder; p++) {
+      double worst = -std::numeric_limits<double>::infinity();
+      for (int i = 0; i <= 100; i++) {
+        worst = std::max(worst, (p + 1)*logs[i] - gaps[i]);
+      }
+      if (worst - std::lgamma(p + 2.0) <= logTolerance) {
+        return p;
+      }
+    }
+    return -1;
+  }
+
+  static const int MaxIfgtDimension = 64;
+
+  static const int MaxIfgtOrder = 12;
+
+  /**
+   * The cost of the exponential of a kernel term, in multiply-adds
+   */
+  static constexpr double ExpCost = 20.0;
+
+  /**
+   * How many times faster ExactSum evaluates a kernel term than the
+   * expansions evaluate one of their terms, as measured with -O2
+   */
+  static constexpr double ExactLanes = 16.0;
+
+  /**
+   * The cost of a call to TruncationOrder, in multiply-adds
+   */
+  static constexpr double OrderCost = 101.0*(ExpCost + MaxIfgtOrder + 1);
+
+  /**
+   * @return The number of monomials of degree at most p in d variables
+   */
+  static double Terms(int d, int p)
+  {
+    double terms = 1.0;
+    for (int i = 1; i <= d; i++) {
+      terms = terms*(p + i)/i;
+    }
+    return terms;
+  }
+
+  double IfgtSum(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, double k) const
+  {
+    const int m = X.rows();
+    const int n = Y.rows();
+    const int d = Y.cols();
+    const double h = std::sqrt(-1.0/k);
+    const int MaxOrder = MaxIfgtOrder;
+    if (d > MaxIfgtDimension) {
+      return ExactSum(X, Y, k);
+    }
+
+    // One sample per column, scaled by the bandwidth
+    const Eigen::MatrixXd sources = Y.transpose()/h;
+    const Eigen::MatrixXd targets = X.transpose()/h;
+
+    // Contributions of sources beyond ry of a center fall under the tolerance
+    const double cutoff = std::sqrt(-std::log(tolerance_));
+
+    // Farthest-point clustering. More centers shrink the radius rx of the
+    // clusters, and with it the degree p that the error bound requires for
+    // the tolerance, but every target is checked against every center. The
+    // number of centers, tried at powers of two, that minimizes the
+    // estimated cost of the expansions is kept.
+    const double exactCost = ((double) m)*n*(d + ExpCost)/ExactLanes;
+    if (exactCost < OrderCost) {
+      return ExactSum(X, Y, k);
+    }
+    double bestCost = exactCost;
+    std::vector<int> bestCluster;
+    int K = 0;
+    int p = -1;
+    double rx = 0.0;
+
+    std::vector<int> centers(1, 0);
+    std::vector<int> cluster(n, 0);
+    Eigen::VectorXd distances = (sources.colwise() - sources.col(0)).colwise().norm().transpose();
+    for (int check = 1; ; ) {
+      int next;
+      double radius = distances.maxCoeff(&next);
+      const int count = centers.size();
+      if (count == check || radius == 0.0) {
+        // Further centers cost at least their distance to every source, and a
+        // kernel term per target. The search stops at a quarter of the best
+        // cost, which bounds its overhead when the sum falls back to ExactSum
+        if (4.0*(OrderCost + ((double) m + n)*count*(d + ExpCost)) >= bestCost) {
+          break;
+        }
+        int order = TruncationOrder(radius, radius + cutoff, 1.0, MaxOrder);
+        if (order >= 0) {
+          // Forming the coefficients of every source, then evaluating every
+          // cluster at every target
+          double cost = (n + ((double) m)*count)*(d + ExpCost + 2.0*Terms(d, order));
+          if (cost < bestCost) {
+            bestCost = cost;
+            bestCluster = cluster;
+            K = count;
+            p = order;
+            rx = radius;
+          }
+        }
+        check *= 2;
+        if (radius == 0.0) {
+          break;
+        }
+      }
+
+      centers.push_back(next);
+      for (int j = 0; j < n; j++) {
+        double distance = (sources.col(j) - sources.col(next)).norm();
+        if (distance < distances[j]) {
+          distances[j] = distance;
+          cluster[j] = count;
+        }
+      }
+    }
+
+    // No expansion within MaxOrder beats the kernel terms themselves
+    if (p < 0) {
+      return ExactSum(X, Y, k);
+    }
+    centers.resize(K);
+    cluster = bestCluster;
+
+    std::vector<std::vector<int>> exponents;
+    Exponents(d, p, exponents);
+    const int P = exponents.size();
+
+    // 2^|alpha|/alpha! for each monomial
+    Eigen::VectorXd constants(P);
+    for (int a = 0; a < P; a++) {
+      double c = 1.0;
+      for (int i = 0; i < d; i++) {
+        c *= std::pow(2.0, exponents[a][i])/std::tgamma(exponents[a][i] + 1.0);
+      }
+      constants[a] = c;
+    }
+
+    // Coefficients of each cluster
+    Eigen::MatrixXd coefficients = Eigen::MatrixXd::Zero(P, K);
+    Eigen::VectorXd v(d);
+    Eigen::VectorXd monomials(P);
+    for (int j = 0; j < n; j++) {
+      v = sources.col(j) - sources.col(centers[cluster[j]]);
+      Monomials(v.data(), d, p, monomials.data());
+      coefficients.col(cluster[j]) += std::exp(-v.squaredNorm())*monomials;
+    }
+    for (int c = 0; c < K; c++) {
+      coefficients.col(c) = coefficients.col(c).cwiseProduct(constants);
+    }
+
+    // Evaluate at every target, from the clusters within the cutoff
+    const double ry = rx + cutoff;
+    double sum = 0.0;
+    for (int i = 0; i < m; i++) {
+      for (int c = 0; c < K; c++) {
+        v = targets.col(i) - sources.col(centers[c]);
+        double squaredNorm = v.squaredNorm();
+        if (squaredNorm > ry*ry) {
+          continue;
+        }
+        Monomials(v.data(), d, p, monomials.data());
+        sum += std::exp(-squaredNorm)*coefficients.col(c).dot(monomials);
+      }
+    }
+    return sum;
+  }
+
+
+  Method method_;
+  double tolerance_;
+};
+
+} // namespace stats
+} // namespace rlfd
+#endif // __KERNELSUMMATION_HH__
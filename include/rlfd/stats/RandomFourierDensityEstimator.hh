@@ -0,0 +1,252 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __RANDOMFOURIERDENSITYESTIMATOR_HH__
+#define __RANDOMFOURIERDENSITYESTIMATOR_HH__
+
+#include <rlfd/utils/ParallelFor.hh>
+#include <rlfd/stats/GaussianDensityEstimator.hh>
+
+#include <Eigen/Core>
+#include <random>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace rlfd {
+namespace stats {
+
+/**
+ * Approximate the distance of GaussianDensityEstimator with random Fourier
+ * features.
+ *
+ * The integrated squared error between the kernel density estimates of two
+ * windows is a squared maximum mean discrepancy under the Gaussian kernel
+ * exp(-||x - y||^2/(2l^2)), with l^2 = 2 sigma^2. Mapping each sample to
+ * phi(x) = sqrt(2/D) cos(Omega'x + b), with the columns of Omega drawn from
+ * N(0, I/l^2) and b uniformly in [0, 2 pi), gives E[phi(x)'phi(y)] = k(x, y).
+ * A window is then summarized by the mean of its features, and the distance
+ * between two windows is proportional to the squared Euclidean distance
+ * between their means: O(D) instead of O(W^2 d).
+ *
+ * The error on the kernel sums decreases as 1/sqrt(D).
+ *
+ * A. Rahimi and B. Recht, "Random Features for Large-Scale Kernel Machines",
+ * in Advances in Neural Information Processing Systems 20, 2007.
+ */
+class RandomFourierDensityEstimator
+{
+ public:
+  /**
+   * @param sigma The bandwidth of the density estimates
+   * @param d The dimensionality of the samples
+   * @param D The number of random features
+   * @param seed Seed of the random features, for reproducible distances
+   */
+  RandomFourierDensityEstimator(double sigma = 1.0, int d = 4, int D = 1024, unsigned seed = 0) :
+      d_(d), D_(D), seed_(seed), sigma_(sigma)
+  {
+    Draw();
+  }
+
+  double GetSigma() { return sigma_; }
+
+  double GetDimensionality() { return d_; }
+
+  int GetFeatures() { return D_; }
+
+  /**
+   * Estimate sigma as GaussianDensityEstimator does, and draw new features.
+   */
+  void Calibrate(const GaussianDensityEstimator::Samples& sample)
+  {
+    GaussianDensityEstimator kde;
+    kde.Calibrate(sample);
+    sigma_ = kde.GetSigma();
+    d_ = sample.cols();
+    Draw();
+  }
+
+  /**
+   * @param X Row vectors
+   * @param out Receives the features of each row of X, as rows
+   */
+  template<typename Derived>
+  void Features(const Eigen::MatrixBase<Derived>& X, Eigen::MatrixXd& out)
+  {
+    out = X*omega_;
+    out.rowwise() += phase_;
+    out = std::sqrt(2.0/D_)*out.array().cos().matrix();
+  }
+
+  /**
+   * Mean features of the windows of W samples starting at 0 .. T-W-1, slid
+   * one sample at a time.
+   * @param means Receives one row per window
+   */
+  void WindowMeans(const GaussianDensityEstimator::Samples& ts, int W, Eigen::MatrixXd& means)
+  {
+    const int N = ts.rows() - W;
+    means.resize(std::max(N, 0), D_);
+
+    Eigen::MatrixXd features;
+    Eigen::RowVectorXd sum;
+    for (int s = 0; s < N; s++) {
+      // Start over every W windows to bound the drift of the running sum
+      if (s % W == 0) {
+        Features(ts.middleRows(s, W), features);
+        sum = features.colwise().sum();
+      } else {
+        Features(ts.row(s - 1), features);
+        sum -= features;
+        Features(ts.row(s + W - 1), features);
+        sum += features;
+      }
+      means.row(s) = sum/W;
+    }
+  }
+
+  /**
+   * Distance between two windows of W samples from their mean features.
+   */
+  template<typename DerivedA, typename DerivedB>
+  double Distance(const Eigen::MatrixBase<DerivedA>& mu, const Eigen::MatrixBase<DerivedB>& nu, int W)
+  {
+    return std::pow(W, 2)*Normalization(W)*(mu - nu).squaredNorm();
+  }
+
+  /**
+   * Approximate distance between the densities estimated in two windows.
+   * @param X W row vectors
+   * @param Xprime W row vectors
+   */
+  template<typename Derived>
+  double operator()(const Eigen::Block<Derived>& X, const Eigen::Block<Derived>& Xprime)
+  {
+    Eigen::MatrixXd features;
+    Features(X, features);
+    Eigen::RowVectorXd mu = features.colwise().mean();
+    Features(Xprime, features);
+    Eigen::RowVectorXd nu = features.colwise().mean();
+    return Distance(mu, nu, X.rows());
+  }
+
+  /**
+   * Compute the approximate distance matrix for overlapping windows spread
+   * appart by one sample, with the same layout as
+   * GaussianDensityEstimator::DistanceMatrix.
+   * @param distancesOut Receives the distances strictly below the diagonal
+   * @param nthreads The number of threads. 0 means one per core.
+   */
+  void DistanceMatrix(const GaussianDensityEstimator::Samples& ts, int W, Eigen::MatrixXd& distancesOut, unsigned nthreads = 1)
+  {
+    DistanceTiles(ts, W, [&](int s0, int t0, const Eigen::MatrixXd& tile) {
+      for (int j = 0; j < tile.cols(); j++) {
+        for (int i = std::max(t0 + j + 1 - s0, 0); i < tile.rows(); i++) {
+          distancesOut(s0 + i, t0 + j) = tile(i, j);
+        }
+      }
+    }, nthreads);
+  }
+
+  /**
+   * Compute the approximate distance matrix one tile at a time.
+   * @see GaussianDensityEstimator::DistanceTiles
+   */
+  template<typename TileSink>
+  void DistanceTiles(const GaussianDensityEstimator::Samples& ts, int W, TileSink sink, unsigned nthreads = 1)
+  {
+    const int N = ts.rows() - W;
+    if (N <= 0) {
+      return;
+    }
+    const int TileSize = GaussianDensityEstimator::GetTileSize();
+    const double factor = std::pow(W, 2)*Normalization(W);
+
+    Eigen::MatrixXd means;
+    WindowMeans(ts, W, means);
+    Eigen::VectorXd squaredNorms = means.rowwise().squaredNorm();
+
+    std::vector<std::pair<int, int>> tiles;
+    for (int s0 = 0; s0 < N; s0 += TileSize) {
+      for (int t0 = 0; t0 <= s0; t0 += TileSize) {
+        tiles.push_back(std::make_pair(s0, t0));
+      }
+    }
+
+    rlfd::utils::ParallelFor(tiles.size(), nthreads, [&](size_t i) {
+      int s0 = tiles[i].first;
+      int t0 = tiles[i].second;
+      int rows = std::min(s0 + TileSize, N) - s0;
+      int cols = std::min(t0 + TileSize, N) - t0;
+
+      // Expanded squared distances between the means, computed as a product
+      Eigen::MatrixXd tile = -2.0*means.middleRows(s0, rows)*means.middleRows(t0, cols).transpose();
+      tile.colwise() += squaredNorms.segment(s0, rows);
+      tile.rowwise() += squaredNorms.segment(t0, cols).transpose();
+      tile = factor*tile.array().max(0.0).matrix();
+
+      for (int j = 0; j < cols; j++) {
+        for (int i = 0; i < std::min(t0 + j + 1 - s0, rows); i++) {
+          tile(i, j) = 0.0;
+        }
+      }
+      sink(s0, t0, tile);
+    });
+  }
+
+ private:
+  /**
+   * Same normalization as GaussianDensityEstimator::GetNormalization
+   */
+  double Normalization(int W)
+  {
+    return GaussianDensityEstimator(sigma_, d_).GetNormalization(W);
+  }
+
+  void Draw()
+  {
+    std::mt19937_64 generator(seed_);
+    std::normal_distribution<double> normal(0.0, 1.0/(std::sqrt(2.0)*sigma_));
+    std::uniform_real_distribution<double> uniform(0.0, 2.0*GaussianDensityEstimator::Pi());
+
+    omega_.resize(d_, D_);
+    for (int j = 0; j < D_; j++) {
+      for (int i = 0; i < d_; i++) {
+        omega_(i, j) = normal(generator);
+      }
+    }
+    phase_.resize(D_);
+    for (int j = 0; j < D_; j++) {
+      phase_[j] = uniform(generator);
+    }
+  }
+
+  int d_;
+  int D_;
+  unsigned seed_;
+  double sigma_;
+
+  Eigen::MatrixXd omega_;
+  Eigen::RowVectorXd phase_;
+};
+
+} // namespace stats
+} // namespace rlfd
+#endif // __RANDOMFOURIERDENSITYESTIMATOR_HH__
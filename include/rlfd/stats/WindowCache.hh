@@ -0,0 +1,182 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __WINDOWCACHE_HH__
+#define __WINDOWCACHE_HH__
+
+#include <Eigen/Core>
+#include <list>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+
+namespace rlfd {
+namespace stats {
+
+/**
+ * Statistics of the windows of a time series, keyed by the index of their
+ * first sample, evicting the least recently used ones beyond a capacity.
+ *
+ * Each entry keeps the self kernel sum of the window and a packed copy of its
+ * samples. Get() compares the copy with the window on every lookup, so that
+ * an entry computed for another series is recomputed rather than reused,
+ * while Find() and Put() leave the keys to callers that only see the windows
+ * of one series. The key does not cover the kernel: entries must be cleared
+ * when it changes. Entries are shared, and outlive their eviction as long as
+ * a caller holds them. At least the two most recent windows are kept,
+ * whatever the capacity. The cache is not thread-safe.
+ */
+class WindowCache
+{
+ public:
+  struct Window {
+    // Sum of the kernel terms between all the pairs of samples of the window
+    double selfSum;
+    // The W samples, contiguous and column-major
+    Eigen::MatrixXd data;
+  };
+
+  WindowCache(size_t capacity = 4096) : capacity_(capacity), W_(0), d_(0), hits_(0), misses_(0) {};
+
+  void SetCapacity(size_t capacity)
+  {
+    capacity_ = capacity;
+    Evict();
+  }
+
+  size_t GetCapacity() { return capacity_; }
+
+  size_t Size() { return index_.size(); }
+
+  size_t GetHits() { return hits_; }
+
+  size_t GetMisses() { return misses_; }
+
+  void Clear()
+  {
+    windows_.clear();
+    index_.clear();
+  }
+
+  /**
+   * Look up the window of W samples starting at start, computing its
+   * statistics with selfSum(window) if it is missing or stale.
+   * @param window The samples of the window, W x d
+   * @param selfSum Called on the packed samples as selfSum(data)
+   */
+  template<typename Derived, typename SelfSum>
+  std::shared_ptr<const Window> Get(int start, const Eigen::MatrixBase<Derived>& window, SelfSum selfSum)
+  {
+    Reshape(window.rows(), window.cols());
+
+    auto it = index_.find(start);
+    if (it != index_.end()) {
+      windows_.splice(windows_.begin(), windows_, it->second);
+      if (it->second->second->data == window) {
+        hits_++;
+        return it->second->second;
+      }
+    }
+
+    misses_++;
+    Eigen::MatrixXd data = window;
+    double sum = selfSum(data);
+    return Insert(start, std::move(data), sum);
+  }
+
+  /**
+   * Look up the window of W samples starting at start, without comparing its
+   * samples.
+   * @return The entry, or null if it is missing
+   */
+  std::shared_ptr<const Window> Find(int start)
+  {
+    auto it = index_.find(start);
+    if (it == index_.end()) {
+      misses_++;
+      return nullptr;
+    }
+    hits_++;
+    windows_.splice(windows_.begin(), windows_, it->second);
+    return it->second->second;
+  }
+
+  /**
+   * Store the statistics of the window of W samples starting at start,
+   * replacing any previous entry.
+   */
+  template<typename Derived>
+  std::shared_ptr<const Window> Put(int start, const Eigen::MatrixBase<Derived>& window, double selfSum)
+  {
+    Reshape(window.rows(), window.cols());
+    return Insert(start, window, selfSum);
+  }
+
+ private:
+  typedef std::pair<int, std::shared_ptr<Window>> Entry;
+
+  /**
+   * Entries of another window size or dimensionality are of no use
+   */
+  void Reshape(int W, int d)
+  {
+    if (W != W_ || d != d_) {
+      Clear();
+      W_ = W;
+      d_ = d;
+    }
+  }
+
+  std::shared_ptr<const Window> Insert(int start, Eigen::MatrixXd data, double selfSum)
+  {
+    std::shared_ptr<Window> entry(new Window{selfSum, std::move(data)});
+    auto it = index_.find(start);
+    if (it != index_.end()) {
+      windows_.erase(it->second);
+    }
+    windows_.push_front(Entry(start, entry));
+    index_[start] = windows_.begin();
+    Evict();
+    return entry;
+  }
+
+  void Evict()
+  {
+    // Keep the two entries compared by a distance evaluation
+    while (windows_.size() > std::max<size_t>(capacity_, 2)) {
+      index_.erase(windows_.back().first);
+      windows_.pop_back();
+    }
+  }
+
+  size_t capacity_;
+  int W_;
+  int d_;
+  size_t hits_;
+  size_t misses_;
+
+  // Most recently used first
+  std::list<Entry> windows_;
+  std::unordered_map<int, std::list<Entry>::iterator> index_;
+};
+
+} // namespace stats
+} // namespace rlfd
+#endif // __WINDOWCACHE_HH__
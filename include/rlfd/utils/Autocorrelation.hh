@@ -20,75 +20,112 @@
 #ifndef __AUTOCORRELATION_HH__
 #define __AUTOCORRELATION_HH__
 
+#include <rlfd/utils/FFTPlans.hh>
+
 #include <fftw3.h>
 #include <Eigen/Core>
+#include <algorithm>
 
 namespace rlfd {
 namespace utils {
 
 /**
- * Compute the sample autocorrelation function for the specified lag.
- * @param ts The time series data
- * @param lag The autocorrelation lag
- * @param outCoeff Output vector for holding the autocorrelation coefficients
+ * Compute the sample autocorrelation functions of several time series at
+ * once. The series are zero-padded into a scratch buffer allocated once, and
+ * transformed in batches of up to BatchSize columns by a single pair of
+ * batched FFTW plans from FFTPlans.
+ * @param series One time series per column
+ * @param outCoeffs Output matrix holding the autocorrelation coefficients of
+ * each series in the corresponding column
  */
-void Autocorrelation(const Eigen::VectorXd& inSeries, Eigen::VectorXd& outCoeff)
+void Autocorrelations(const Eigen::Ref<const Eigen::MatrixXd>& series, Eigen::MatrixXd& outCoeffs)
 {
-  // FFTW is optimized for powers of 2.
-  int n = std::exp2(std::ceil(std::log2(inSeries.size())));
+  const int BatchSize = 64;
 
-  // Zero-pad so that the length is a power of two. Remove the mean 
-  EIGEN_ALIGN16 Eigen::VectorXd series(n);
-  series << (inSeries.array() - inSeries.mean()), Eigen::VectorXd::Zero(n - inSeries.size());
+  // FFTW is optimized for powers of 2.
+  const int T = series.rows();
+  const int n = std::exp2(std::ceil(std::log2(T)));
 
   // Negative-frequency amplitudes for real data are the complex conjugate of
-  // the positive-frequency amplitudes 
-  int nc = (n+1)/2;
-
-  // Use fftw_malloc to ensure 16-bytes alignment.  
-  double* out = (double*) fftw_malloc(sizeof(double)*n); 
-  double* power_spectrum = (double *) fftw_malloc(sizeof(double)*n); 
-
-  // Compute the Fourier transform of the input time series
-  fftw_plan plan_forward = fftw_plan_r2r_1d(n, series.data(), out, FFTW_R2HC, FFTW_ESTIMATE);
-  fftw_execute(plan_forward);
-  fftw_destroy_plan(plan_forward);
-
-  // Compute the Power Spectral Density (PSD)
-  // The PSD is the squares of the absolute values of the DFT amplitudes.
-  power_spectrum[0] = (out[0]*out[0]);  // DC component
-  for (int k = 1; k < nc; k++) { 
-    // The DFT output satisfies the “Hermitian” redundancy: out[i] is the
-    // conjugate of out[n-i]
-    power_spectrum[k] = (out[k]*out[k] + out[n-k]*out[n-k]);
-  }
-  // Nyquist freq.
-  if (n % 2 == 0) {
-    power_spectrum[n/2] = (out[n/2]*out[n/2]);
+  // the positive-frequency amplitudes, so only n/2+1 of them are computed
+  const int nc = (n+1)/2;
+  const int nf = n/2 + 1;
+  outCoeffs.resize(nc, series.cols());
+  if (series.cols() == 0) {
+    return;
   }
 
-  // Set imaginary part to 0 in preparation to ifft
-  for (int k = nc; k < n; k++) {
-    power_spectrum[k] = 0;
+  // Use fftw_malloc so that the alignment matches the one of the plans.
+  const int batch = std::min<int>(series.cols(), BatchSize);
+  double* scratch = fftw_alloc_real(n*batch);
+  fftw_complex* spectra = fftw_alloc_complex(nf*batch);
+  Eigen::Map<Eigen::MatrixXd> padded(scratch, n, batch);
+
+  for (int c0 = 0; c0 < series.cols(); c0 += batch) {
+    const int count = std::min<int>(batch, series.cols() - c0);
+    const FFTPlans::Plan& plan = FFTPlans::Instance().Get(n, count);
+
+    // Zero-pad so that the length is a power of two. Remove the mean
+    for (int j = 0; j < count; j++) {
+      padded.col(j).head(T) = series.col(c0 + j).array() - series.col(c0 + j).mean();
+      padded.col(j).tail(n - T).setZero();
+    }
+
+    // Compute the Fourier transform of the input time series
+    fftw_execute_dft_r2c(plan.forward, scratch, spectra);
+
+    // Compute the Power Spectral Density (PSD)
+    // The PSD is the squares of the absolute values of the DFT amplitudes.
+    for (int k = 0; k < nf*count; k++) {
+      spectra[k][0] = spectra[k][0]*spectra[k][0] + spectra[k][1]*spectra[k][1];
+      spectra[k][1] = 0.0;
+    }
+
+    // By the Wiener–Khinchin theorem, the power spectral density of a
+    // wide-sense-stationary random process is the Fourier transform of the
+    // autocorrelation function.
+    fftw_execute_dft_c2r(plan.backward, spectra, scratch);
+
+    // Normalize the ACF as in Matlab, from Box, Jenkins, Reinsel, pages 30-34, 188.
+    // This also cancels the factor n of the unnormalized transforms.
+    for (int j = 0; j < count; j++) {
+      outCoeffs.col(c0 + j) = padded.col(j).head(nc)*(1.0/padded(0, j));
+    }
   }
 
-  // By the Wiener–Khinchin theorem, the power spectral density of a
-  // wide-sense-stationary random process is the Fourier transform of the
-  // autocorrelation function.
-  fftw_plan plan_backward = fftw_plan_r2r_1d(n, power_spectrum, out, FFTW_HC2R, FFTW_ESTIMATE);
-  fftw_execute(plan_backward);
-  fftw_destroy_plan(plan_backward);
-  fftw_cleanup();
- 
-  // RFFTW transforms are unnormalized. Applying the forward and then the
-  // backward transform will multiply the input by n.
-  outCoeff = Eigen::VectorXd::Map(out, nc).array()*(1.0/n);
-
-  // Normalize the ACF as in Matlab, from Box, Jenkins, Reinsel, pages 30-34, 188. 
-  outCoeff = outCoeff.array() * (1.0/outCoeff[0]);
-
-  fftw_free(out);
-  fftw_free(power_spectrum);
+  fftw_free(scratch);
+  fftw_free(spectra);
+}
+
+/**
+ * Compute the sample autocorrelation function for the specified lag.
+ * The transforms reuse the plans of FFTPlans, so that repeated calls only
+ * pay for the FFTs, and concurrent calls are safe.
+ * @param ts The time series data
+ * @param lag The autocorrelation lag
+ * @param outCoeff Output vector for holding the autocorrelation coefficients
+ */
+void Autocorrelation(const Eigen::VectorXd& inSeries, Eigen::VectorXd& outCoeff)
+{
+  Eigen::MatrixXd coeffs;
+  Autocorrelations(inSeries, coeffs);
+  outCoeff = coeffs.col(0);
+}
+
+/**
+ * Compute the short-time autocorrelation functions of a time series, over
+ * sliding windows read in place and transformed in batches.
+ * @param ts The time series data
+ * @param window The number of samples of each window
+ * @param step The number of samples between the starts of consecutive windows
+ * @param outCoeffs Output matrix holding the autocorrelation coefficients of
+ * the window starting at j*step in column j
+ */
+void SlidingAutocorrelation(const Eigen::VectorXd& ts, int window, int step, Eigen::MatrixXd& outCoeffs)
+{
+  int count = ts.size() >= window ? (ts.size() - window)/step + 1 : 0;
+  Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<>> windows(ts.data(), window, count, Eigen::OuterStride<>(step));
+  Autocorrelations(windows, outCoeffs);
 }
 
 } // namespace utils
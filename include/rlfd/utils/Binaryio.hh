@@ -0,0 +1,199 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __BINARYIO_HH__
+#define __BINARYIO_HH__
+
+#include <rlfd/utils/Matrixio.hh>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fstream>
+
+namespace rlfd {
+namespace utils {
+
+/**
+ * Compact binary matrix format, memory-mapped on read.
+ *
+ * Layout: a 32 bytes header made of an 8 bytes magic number, the number of
+ * rows and columns as 64 bits integers, the element type (0 for double, 1
+ * for float) and the storage order (0 for column-major, 1 for row-major) as
+ * 32 bits integers. The elements follow, in native byte order.
+ */
+template<typename MatrixType=Eigen::MatrixXd>
+class Binaryio : public Matrixio<MatrixType>
+{
+ public:
+  enum { Float64 = 0, Float32 = 1 };
+  enum { ColMajor = 0, RowMajor = 1 };
+
+  Binaryio() : fd_(-1), mapping_(MAP_FAILED), length_(0) {};
+  virtual ~Binaryio()
+  {
+    Close();
+  };
+
+  /**
+   * @return true if filename starts with the magic number of this format
+   */
+  static bool IsBinary(const std::string& filename)
+  {
+    char magic[8];
+    std::ifstream file(filename, std::ifstream::in | std::ifstream::binary);
+    return file.read(magic, sizeof(magic)) && memcmp(magic, Magic(), sizeof(magic)) == 0;
+  }
+
+  /**
+   * Write a matrix in this format, keeping its storage order.
+   */
+  static void Write(const std::string& filename, const MatrixType& mat) throw(std::runtime_error)
+  {
+    std::ofstream file(filename, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!file) {
+      throw std::runtime_error("Failed to open " + filename);
+    }
+
+    Header header;
+    memcpy(header.magic, Magic(), sizeof(header.magic));
+    header.rows = mat.rows();
+    header.cols = mat.cols();
+    header.dtype = Float64;
+    header.layout = MatrixType::IsRowMajor ? RowMajor : ColMajor;
+
+    // Evaluate expressions and convert scalars into plain doubles
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+        MatrixType::IsRowMajor ? Eigen::RowMajor : Eigen::ColMajor> plain = mat.template cast<double>();
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(plain.data()), sizeof(double)*plain.size());
+    if (!file) {
+      throw std::runtime_error("Failed to write " + filename);
+    }
+  }
+
+  void Open(const std::string& filename) throw(std::runtime_error)
+  {
+    Close();
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      throw std::runtime_error(strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+      throw std::runtime_error(strerror(errno));
+    }
+    length_ = st.st_size;
+    if (length_ < sizeof(Header)) {
+      throw std::runtime_error(filename + " is too short to be a binary matrix");
+    }
+
+    mapping_ = mmap(NULL, length_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (mapping_ == MAP_FAILED) {
+      throw std::runtime_error(strerror(errno));
+    }
+
+    memcpy(&header_, mapping_, sizeof(Header));
+    size_t elementSize = header_.dtype == Float32 ? sizeof(float) : sizeof(double);
+    if (memcmp(header_.magic, Magic(), sizeof(header_.magic)) != 0 ||
+        (header_.dtype != Float64 && header_.dtype != Float32) ||
+        length_ < sizeof(Header) + header_.rows*header_.cols*elementSize) {
+      throw std::runtime_error(filename + " is not a valid binary matrix");
+    }
+  }
+
+  void Read(MatrixType& out) throw(std::runtime_error)
+  {
+    if (header_.dtype == Float32) {
+      ReadAs<float>(out);
+    } else {
+      ReadAs<double>(out);
+    }
+  }
+
+  /**
+   * Zero-copy access to a column-major matrix of doubles. The map remains
+   * valid until Close() is called.
+   */
+  Eigen::Map<const Eigen::MatrixXd> Map() const throw(std::runtime_error)
+  {
+    if (header_.dtype != Float64 || header_.layout != ColMajor) {
+      throw std::runtime_error("Only column-major matrices of doubles can be mapped");
+    }
+    return Eigen::Map<const Eigen::MatrixXd>(Data<double>(), header_.rows, header_.cols);
+  }
+
+  void Close(void) throw(std::runtime_error)
+  {
+    if (mapping_ != MAP_FAILED) {
+      munmap(mapping_, length_);
+      mapping_ = MAP_FAILED;
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+ private:
+  struct Header {
+    char magic[8];
+    uint64_t rows;
+    uint64_t cols;
+    uint32_t dtype;
+    uint32_t layout;
+  };
+
+  static const char* Magic() { return "RLFDMAT1"; }
+
+  template<typename Scalar>
+  const Scalar* Data() const
+  {
+    return reinterpret_cast<const Scalar*>(static_cast<const char*>(mapping_) + sizeof(Header));
+  }
+
+  template<typename Scalar>
+  void ReadAs(MatrixType& out)
+  {
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor> ColMajorType;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorType;
+
+    if (header_.layout == RowMajor) {
+      out = Eigen::Map<const RowMajorType>(Data<Scalar>(), header_.rows, header_.cols).template cast<typename MatrixType::Scalar>();
+    } else {
+      out = Eigen::Map<const ColMajorType>(Data<Scalar>(), header_.rows, header_.cols).template cast<typename MatrixType::Scalar>();
+    }
+  }
+
+  int fd_;
+  void* mapping_;
+  size_t length_;
+  Header header_;
+};
+
+} // namespace utils
+} // namespace rlfd
+#endif // __BINARYIO_HH__
@@ -0,0 +1,281 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __DISTANCESTORE_HH__
+#define __DISTANCESTORE_HH__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <Eigen/Core>
+
+namespace rlfd {
+namespace utils {
+
+/**
+ * On-disk store for a symmetric distance matrix too large to be held in
+ * memory. Only the lower triangle is kept, as square tiles of doubles laid
+ * out row of tiles after row of tiles. Tiles can be written in any order and
+ * from several threads, and the matrix is read back one panel of columns at a
+ * time.
+ *
+ * Layout: an 8 bytes magic number, the matrix size and the tile size as
+ * 64 bits integers, followed by the tiles (I, J), J <= I, at index
+ * I(I+1)/2 + J. Each tile holds TileSize x TileSize column-major doubles,
+ * zero-padded on the edges of the matrix.
+ */
+class DistanceStore
+{
+ public:
+  DistanceStore() : fd_(-1), size_(0), tileSize_(0) {};
+
+  ~DistanceStore()
+  {
+    Close();
+  }
+
+  /**
+   * @return true if filename starts with the magic number of a store
+   */
+  static bool IsStore(const std::string& filename)
+  {
+    char magic[8];
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    bool isStore = (pread(fd, magic, sizeof(magic), 0) == sizeof(magic) &&
+                    memcmp(magic, Magic(), sizeof(magic)) == 0);
+    close(fd);
+    return isStore;
+  }
+
+  /**
+   * Create a new store, truncating any existing file.
+   * @param size The number of rows and columns of the matrix
+   * @param tileSize The number of rows and columns of a tile
+   */
+  void Create(const std::string& filename, int size, int tileSize) throw(std::runtime_error)
+  {
+    Close();
+    fd_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+      throw std::runtime_error(strerror(errno));
+    }
+    size_ = size;
+    tileSize_ = tileSize;
+
+    uint64_t header[3];
+    memcpy(&header[0], Magic(), sizeof(header[0]));
+    header[1] = size_;
+    header[2] = tileSize_;
+    Write(header, sizeof(header), 0);
+
+    // Reserve the whole file so that unwritten tiles read back as zeros
+    int tiles = Tiles();
+    if (tiles > 0 && ftruncate(fd_, TileOffset(tiles - 1, tiles - 1) + TileBytes()) != 0) {
+      throw std::runtime_error(strerror(errno));
+    }
+  }
+
+  void Open(const std::string& filename) throw(std::runtime_error)
+  {
+    Close();
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      throw std::runtime_error(strerror(errno));
+    }
+
+    uint64_t header[3];
+    Read(header, sizeof(header), 0);
+    if (memcmp(&header[0], Magic(), sizeof(header[0])) != 0) {
+      throw std::runtime_error(filename + " is not a distance store");
+    }
+    size_ = header[1];
+    tileSize_ = header[2];
+  }
+
+  void Close(void)
+  {
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  int Size() const { return size_; }
+
+  int TileSize() const { return tileSize_; }
+
+  /**
+   * Write the tile whose upper-left corner is at (s0, t0)
+   * @param s0 The first row, a multiple of the tile size
+   * @param t0 The first column, a multiple of the tile size, t0 <= s0
+   * @param tile At most TileSize x TileSize values
+   */
+  void WriteTile(int s0, int t0, const Eigen::MatrixXd& tile) throw(std::runtime_error)
+  {
+    Eigen::MatrixXd padded = Eigen::MatrixXd::Zero(tileSize_, tileSize_);
+    padded.topLeftCorner(tile.rows(), tile.cols()) = tile;
+    Write(padded.data(), TileBytes(), TileOffset(s0/tileSize_, t0/tileSize_));
+  }
+
+  /**
+   * Read the full symmetric columns [t0, t0 + TileSize), clipped to the size of
+   * the matrix.
+   * @param t0 The first column, a multiple of the tile size
+   * @param panel Output Size() x TileSize matrix
+   */
+  void ReadColumns(int t0, Eigen::MatrixXd& panel) throw(std::runtime_error)
+  {
+    const int J = t0/tileSize_;
+    const int cols = std::min(tileSize_, size_ - t0);
+    panel.resize(size_, cols);
+
+    Eigen::MatrixXd tile(tileSize_, tileSize_);
+    for (int I = 0; I < Tiles(); I++) {
+      const int s0 = I*tileSize_;
+      const int rows = std::min(tileSize_, size_ - s0);
+
+      if (I > J) {
+        Read(tile.data(), TileBytes(), TileOffset(I, J));
+        panel.block(s0, 0, rows, cols) = tile.topLeftCorner(rows, cols);
+      } else if (I < J) {
+        // Rows above the diagonal are the transposed tile (J, I)
+        Read(tile.data(), TileBytes(), TileOffset(J, I));
+        panel.block(s0, 0, rows, cols) = tile.topLeftCorner(cols, rows).transpose();
+      } else {
+        Read(tile.data(), TileBytes(), TileOffset(I, J));
+        auto lower = tile.topLeftCorner(rows, cols);
+        panel.block(s0, 0, rows, cols) = lower + lower.transpose();
+      }
+    }
+  }
+
+ private:
+  static const char* Magic() { return "RLFDDST1"; }
+
+  int Tiles() const { return (size_ + tileSize_ - 1)/tileSize_; }
+
+  size_t TileBytes() const { return sizeof(double)*tileSize_*tileSize_; }
+
+  off_t TileOffset(int I, int J) const
+  {
+    return 3*sizeof(uint64_t) + (((off_t) I)*(I + 1)/2 + J)*TileBytes();
+  }
+
+  void Write(const void* buffer, size_t count, off_t offset) throw(std::runtime_error)
+  {
+    const char* ptr = static_cast<const char*>(buffer);
+    while (count > 0) {
+      ssize_t written = pwrite(fd_, ptr, count, offset);
+      if (written < 0) {
+        throw std::runtime_error(strerror(errno));
+      }
+      ptr += written;
+      offset += written;
+      count -= written;
+    }
+  }
+
+  void Read(void* buffer, size_t count, off_t offset) throw(std::runtime_error)
+  {
+    char* ptr = static_cast<char*>(buffer);
+    while (count > 0) {
+      ssize_t nread = pread(fd_, ptr, count, offset);
+      if (nread < 0) {
+        throw std::runtime_error(strerror(errno));
+      } else if (nread == 0) {
+        throw std::runtime_error("Truncated distance store");
+      }
+      ptr += nread;
+      offset += nread;
+      count -= nread;
+    }
+  }
+
+  int fd_;
+  int size_;
+  int tileSize_;
+};
+
+/**
+ * Sequential access to the full symmetric columns of a distance matrix
+ * held in memory, of which only the lower triangle is read.
+ */
+template<typename Derived>
+class DenseColumns
+{
+ public:
+  DenseColumns(const Eigen::MatrixBase<Derived>& distances) : distances_(distances), column_(distances.cols()) {};
+
+  int Size() const { return distances_.cols(); }
+
+  const Eigen::VectorXd& Column(int t)
+  {
+    for (int s = 0; s < Size(); s++) {
+      column_[s] = t > s ? distances_(t, s) : distances_(s, t);
+    }
+    return column_;
+  }
+
+ private:
+  const Eigen::MatrixBase<Derived>& distances_;
+  Eigen::VectorXd column_;
+};
+
+/**
+ * Sequential access to the columns of a DistanceStore. Only the current
+ * panel of TileSize columns is held in memory.
+ */
+class TiledColumns
+{
+ public:
+  TiledColumns(DistanceStore& store) : store_(store), panelStart_(-1) {};
+
+  int Size() const { return store_.Size(); }
+
+  const Eigen::VectorXd& Column(int t)
+  {
+    int t0 = t - t % store_.TileSize();
+    if (t0 != panelStart_) {
+      store_.ReadColumns(t0, panel_);
+      panelStart_ = t0;
+    }
+    column_ = panel_.col(t - t0);
+    return column_;
+  }
+
+ private:
+  DistanceStore& store_;
+  Eigen::MatrixXd panel_;
+  int panelStart_;
+  Eigen::VectorXd column_;
+};
+
+} // namespace utils
+} // namespace rlfd
+#endif // __DISTANCESTORE_HH__
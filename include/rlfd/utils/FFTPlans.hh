@@ -0,0 +1,176 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca> 
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __FFTPLANS_HH__
+#define __FFTPLANS_HH__
+
+#include <fftw3.h>
+
+#include <map>
+#include <utility>
+#include <mutex>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace rlfd {
+namespace utils {
+
+/**
+ * Process-wide cache of FFTW plans for real transforms, keyed by their size
+ * and the number of transforms they compute at once.
+ *
+ * Plans are created once, on scratch buffers, and then executed on the
+ * caller's buffers with the new-array interface, which FFTW allows from
+ * several threads at once. Only the planner is serialized. Buffers must come
+ * from fftw_malloc so that their alignment matches the planning buffers.
+ *
+ * When the RLFD_FFTW_WISDOM environment variable names a file, its wisdom is
+ * imported when the cache is first used, plans are measured with FFTW_MEASURE
+ * instead of estimated, and the accumulated wisdom is written back on exit.
+ * Measuring is then only paid once per size across runs.
+ */
+class FFTPlans
+{
+ public:
+  /**
+   * Forward real-to-complex and backward complex-to-real transforms of n
+   * reals and n/2+1 complex numbers. Batches of transforms are stored one
+   * after the other.
+   */
+  struct Plan {
+    fftw_plan forward;
+    fftw_plan backward;
+  };
+
+  static FFTPlans& Instance()
+  {
+    static FFTPlans instance;
+    return instance;
+  }
+
+  /**
+   * @param flags The planner flags of the plans created from now on, such as
+   * FFTW_ESTIMATE or FFTW_MEASURE
+   */
+  void SetFlags(unsigned flags)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flags_ = flags;
+  }
+
+  unsigned GetFlags()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flags_;
+  }
+
+  /**
+   * @return true if the wisdom of filename was imported
+   */
+  bool LoadWisdom(const std::string& filename)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fftw_import_wisdom_from_filename(filename.c_str()) != 0;
+  }
+
+  /**
+   * @return true if the wisdom gathered so far was written to filename
+   */
+  bool SaveWisdom(const std::string& filename)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fftw_export_wisdom_to_filename(filename.c_str()) != 0;
+  }
+
+  /**
+   * @param n The size of the transforms
+   * @param howmany The number of transforms computed at once, on n reals
+   * and n/2+1 complex numbers apart
+   * @return The plans, created on first use. They remain valid for the
+   * lifetime of the process.
+   */
+  const Plan& Get(int n, int howmany = 1) throw(std::runtime_error)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key = std::make_pair(n, howmany);
+    auto it = plans_.find(key);
+    if (it != plans_.end()) {
+      return it->second;
+    }
+
+    // Measuring overwrites the buffers, so plan on scratch ones
+    const int nc = n/2 + 1;
+    double* real = fftw_alloc_real(n*howmany);
+    fftw_complex* complex = fftw_alloc_complex(nc*howmany);
+    Plan plan;
+    if (howmany == 1) {
+      plan.forward = fftw_plan_dft_r2c_1d(n, real, complex, flags_);
+      plan.backward = fftw_plan_dft_c2r_1d(n, complex, real, flags_);
+    } else {
+      plan.forward = fftw_plan_many_dft_r2c(1, &n, howmany, real, NULL, 1, n, complex, NULL, 1, nc, flags_);
+      plan.backward = fftw_plan_many_dft_c2r(1, &n, howmany, complex, NULL, 1, nc, real, NULL, 1, n, flags_);
+    }
+    fftw_free(real);
+    fftw_free(complex);
+    if (plan.forward == NULL || plan.backward == NULL) {
+      throw std::runtime_error("Failed to create the FFTW plans of size " + std::to_string(n));
+    }
+
+    created_ = true;
+    return plans_.insert(std::make_pair(key, plan)).first->second;
+  }
+
+  ~FFTPlans()
+  {
+    if (created_ && wisdom_ != "") {
+      fftw_export_wisdom_to_filename(wisdom_.c_str());
+    }
+    for (auto& entry : plans_) {
+      fftw_destroy_plan(entry.second.forward);
+      fftw_destroy_plan(entry.second.backward);
+    }
+    fftw_cleanup();
+  }
+
+ private:
+  FFTPlans() : flags_(FFTW_ESTIMATE), created_(false)
+  {
+    const char* wisdom = std::getenv("RLFD_FFTW_WISDOM");
+    if (wisdom != NULL && *wisdom != '\0') {
+      wisdom_ = wisdom;
+      fftw_import_wisdom_from_filename(wisdom);
+      flags_ = FFTW_MEASURE;
+    }
+  }
+
+  FFTPlans(const FFTPlans&);
+  FFTPlans& operator=(const FFTPlans&);
+
+  std::mutex mutex_;
+  std::map<std::pair<int, int>, Plan> plans_;
+  unsigned flags_;
+  bool created_;
+  std::string wisdom_;
+};
+
+} // namespace utils
+} // namespace rlfd
+
+#endif // __FFTPLANS_HH__
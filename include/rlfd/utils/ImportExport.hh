@@ -22,8 +22,11 @@
 
 #include <rlfd/utils/Matio.hh>
 #include <rlfd/utils/Tabulario.hh>
+#include <rlfd/utils/Binaryio.hh>
 
 #include <string>
+#include <limits>
+#include <fstream>
 #include <stdexcept>
 #include <Eigen/Core>
 #include <iostream>
@@ -41,12 +44,13 @@ void Import(MatrixType& out)
 template<typename MatrixType=Eigen::MatrixXd>
 void Import(const std::string& filename, MatrixType& out)
 {
-  // @TODO Rely on extensions, for now
   std::string extension = filename.substr(filename.find_last_of(".") + 1);
 
   rlfd::utils::Matrixio<MatrixType>* mat;
 
-  if (extension == "mat") {
+  if (extension == "bin" || rlfd::utils::Binaryio<MatrixType>::IsBinary(filename)) {
+    mat = new rlfd::utils::Binaryio<MatrixType>();
+  } else if (extension == "mat") {
     mat = new rlfd::utils::Matio<MatrixType>();
   } else {
     mat = new rlfd::utils::Tabulario<MatrixType>();
@@ -55,6 +59,36 @@ void Import(const std::string& filename, MatrixType& out)
   mat->Open(filename);
   mat->Read(out);
   mat->Close();
+  delete mat;
+}
+
+// Write to stdout
+template<typename MatrixType=Eigen::MatrixXd>
+void Export(const MatrixType& mat)
+{
+  std::cout.precision(std::numeric_limits<double>::digits10);
+  std::cout << mat << std::endl;
+}
+
+/**
+ * Write to a binary file if filename ends with .bin, or as tabular text
+ * otherwise.
+ */
+template<typename MatrixType=Eigen::MatrixXd>
+void Export(const std::string& filename, const MatrixType& mat) throw(std::runtime_error)
+{
+  std::string extension = filename.substr(filename.find_last_of(".") + 1);
+
+  if (extension == "bin") {
+    rlfd::utils::Binaryio<MatrixType>::Write(filename, mat);
+  } else {
+    std::ofstream file(filename);
+    if (!file) {
+      throw std::runtime_error("Failed to open " + filename);
+    }
+    file.precision(std::numeric_limits<double>::digits10);
+    file << mat << std::endl;
+  }
 }
 
 } // namespace utils
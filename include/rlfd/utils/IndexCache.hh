@@ -0,0 +1,210 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __INDEX_CACHE_HH__
+#define __INDEX_CACHE_HH__
+
+#include <rlfd/utils/KdTree.hh>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <Eigen/Core>
+
+namespace rlfd {
+namespace utils {
+
+/**
+ * Directory of saved kd-tree indexes, named after a fingerprint of the
+ * points they were built on.
+ *
+ * The fingerprint is a 64-bit FNV-1a hash of the build parameters, the
+ * dimensions of the points and their coordinates, so that the index of
+ * changed data or parameters is simply not found and built again. Each index
+ * is saved along with a description of what it was built from, written last,
+ * and is only loaded when the description matches and flann reads back an
+ * index of the same size. Anything else is rebuilt and saved over it.
+ */
+class IndexCache
+{
+ public:
+  /**
+   * Bumped whenever the saved indexes change meaning
+   */
+  static const int Version = 1;
+
+  /**
+   * @param directory Created if missing
+   */
+  explicit IndexCache(const std::string& directory) throw(std::runtime_error) : directory_(directory), loaded_(false)
+  {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+      throw std::runtime_error(directory + ": " + strerror(errno));
+    }
+  }
+
+  /**
+   * Load the index of the rows of X from the cache, or build it and save it
+   * there.
+   * @param X The points, which must outlive the index
+   */
+  template<typename Derived>
+  std::unique_ptr<KdTree> Get(const Eigen::DenseBase<Derived>& X) throw(std::runtime_error)
+  {
+    const std::string key = Key(X);
+    const std::string path = directory_ + "/" + key;
+    const std::string description = Describe(X, key);
+
+    if (Read(path + ".meta") == description) {
+      try {
+        std::unique_ptr<KdTree> index(new KdTree(X, path + ".idx"));
+        loaded_ = true;
+        return index;
+      } catch (const std::exception&) {
+        // Truncated or corrupted, built again below
+      }
+    }
+
+    std::unique_ptr<KdTree> index(new KdTree(X));
+    loaded_ = false;
+
+    // Written under unique temporary names and renamed, so that concurrent
+    // users of the cache, whether processes or threads, never see a partial
+    // index
+    const std::string idx = Temporary(path + ".idx");
+    const std::string temporary = Temporary(path + ".meta");
+    index->Save(idx);
+    std::ofstream meta(temporary);
+    meta << description;
+    meta.close();
+    if (!meta || std::rename(idx.c_str(), (path + ".idx").c_str()) != 0 ||
+        std::rename(temporary.c_str(), (path + ".meta").c_str()) != 0) {
+      const std::string error = strerror(errno);
+      unlink(idx.c_str());
+      unlink(temporary.c_str());
+      throw std::runtime_error(path + ": " + error);
+    }
+    return index;
+  }
+
+  /**
+   * @return Whether the last index returned by Get was loaded rather than
+   * built
+   */
+  bool WasLoaded() { return loaded_; }
+
+  /**
+   * @return The fingerprint of the rows of X, as 16 hexadecimal digits
+   */
+  template<typename Derived>
+  static std::string Key(const Eigen::DenseBase<Derived>& X)
+  {
+    uint64_t hash = 14695981039346656037ULL;
+    auto fnv1a = [&hash](const void* data, size_t size) {
+      const unsigned char* bytes = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i])*1099511628211ULL;
+      }
+    };
+
+    const std::string parameters = Parameters();
+    fnv1a(parameters.data(), parameters.size());
+    const uint64_t dimensions[2] = {(uint64_t) X.rows(), (uint64_t) X.cols()};
+    fnv1a(dimensions, sizeof(dimensions));
+    for (int i = 0; i < X.rows(); i++) {
+      for (int j = 0; j < X.cols(); j++) {
+        const double x = X(i, j);
+        fnv1a(&x, sizeof(x));
+      }
+    }
+
+    std::stringstream key;
+    key << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return key.str();
+  }
+
+ private:
+  /**
+   * What the indexes depend on besides the points: the format of this cache,
+   * flann and the parameters of KdTree
+   */
+  static std::string Parameters()
+  {
+    std::string parameters = "rlfd-index-cache " + std::to_string(Version);
+#ifdef FLANN_VERSION_
+    parameters += " flann " FLANN_VERSION_;
+#endif
+    return parameters + " kdtree-single";
+  }
+
+  /**
+   * Create an empty file with a unique name in the cache directory
+   * @return Its name, prefix followed by a random suffix
+   */
+  static std::string Temporary(const std::string& prefix) throw(std::runtime_error)
+  {
+    std::string name = prefix + ".XXXXXX";
+    int fd = mkstemp(&name[0]);
+    if (fd < 0) {
+      throw std::runtime_error(prefix + ": " + strerror(errno));
+    }
+    // mkstemp creates it readable by its owner only
+    fchmod(fd, 0644);
+    close(fd);
+    return name;
+  }
+
+  template<typename Derived>
+  static std::string Describe(const Eigen::DenseBase<Derived>& X, const std::string& key)
+  {
+    std::stringstream description;
+    description << Parameters() << std::endl << X.rows() << " " << X.cols() << std::endl << key << std::endl;
+    return description.str();
+  }
+
+  /**
+   * @return The content of the file, or nothing if missing
+   */
+  static std::string Read(const std::string& filename)
+  {
+    std::ifstream file(filename);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+  }
+
+  std::string directory_;
+  bool loaded_;
+};
+
+} // namespace utils
+} // namespace rlfd
+
+#endif // __INDEX_CACHE_HH__
@@ -0,0 +1,184 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __KD_TREE_HH__
+#define __KD_TREE_HH__
+
+#include <flann/flann.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <Eigen/Core>
+
+namespace rlfd {
+namespace utils {
+
+/**
+ * The rows of an Eigen matrix or view as a flann matrix.
+ *
+ * flann reads each row as contiguous coordinates, but steps from one row to
+ * the next with any stride, so that the rows are handed over in place when
+ * their coordinates are contiguous: row-major matrices and blocks of their
+ * rows, single columns, or the delay vectors of a scalar series with a lag of
+ * 1. Other layouts are copied once into a row-major buffer owned by this.
+ * Rows handed over in place must outlive this.
+ */
+class FlannMatrix
+{
+ public:
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrixXd;
+
+  template<typename Derived>
+  explicit FlannMatrix(const Eigen::DenseBase<Derived>& X)
+  {
+    const Derived& rows = X.derived();
+
+    // Strides between consecutive rows and consecutive coordinates
+    const long rowStride = Derived::IsRowMajor ? rows.outerStride() : rows.innerStride();
+    const long colStride = Derived::IsRowMajor ? rows.innerStride() : rows.outerStride();
+
+    if (colStride == 1 || rows.cols() == 1) {
+      matrix_ = flann::Matrix<double>(const_cast<double*>(rows.data()), rows.rows(), rows.cols(),
+                                      rowStride*sizeof(double));
+    } else {
+      copy_ = rows;
+      matrix_ = flann::Matrix<double>(copy_.data(), copy_.rows(), copy_.cols());
+    }
+  }
+
+  FlannMatrix(const FlannMatrix&) = delete;
+  FlannMatrix& operator=(const FlannMatrix&) = delete;
+
+  flann::Matrix<double>& Get() { return matrix_; }
+
+  /**
+   * @return Whether the rows had to be copied
+   */
+  bool IsCopy() const { return copy_.size() > 0; }
+
+ private:
+  RowMajorMatrixXd copy_;
+  flann::Matrix<double> matrix_;
+};
+
+/**
+ * A flann kd-tree over the rows of an Eigen matrix or view. It owns the index
+ * and the adapted rows, and the neighbors found are written to Eigen
+ * matrices, so that nothing is left to free. Distances are squared, as flann
+ * computes them under L2.
+ */
+class KdTree
+{
+ public:
+  typedef Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Indices;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Distances;
+
+  /**
+   * Build the tree over the rows of X
+   */
+  template<typename Derived>
+  explicit KdTree(const Eigen::DenseBase<Derived>& X) :
+      points_(X),
+      index_(new flann::Index<flann::L2<double>>(points_.Get(), flann::KDTreeSingleIndexParams()))
+  {
+    index_->buildIndex();
+  }
+
+  /**
+   * Load a tree saved over the rows of X
+   * @param filename The path to the index file
+   */
+  template<typename Derived>
+  KdTree(const Eigen::DenseBase<Derived>& X, const std::string& filename) throw(std::runtime_error) :
+      points_(X),
+      index_(new flann::Index<flann::L2<double>>(points_.Get(), flann::SavedIndexParams(filename)))
+  {
+    if (index_->size() != points_.Get().rows || index_->veclen() != points_.Get().cols) {
+      throw std::runtime_error(filename + " does not index these points");
+    }
+  }
+
+  /**
+   * @param filename The path to the index file
+   */
+  void Save(const std::string& filename) { index_->save(filename); }
+
+  /**
+   * Find the k nearest neighbors of each query row, nearest first.
+   * @param indices Output row of the neighbors for each query
+   * @param dists Output squared distances to the neighbors
+   */
+  template<typename Derived>
+  void Knn(const Eigen::DenseBase<Derived>& queries, int k, Indices& indices, Distances& dists)
+  {
+    FlannMatrix query(queries);
+    KnnSearch(query.Get(), k, indices, dists);
+  }
+
+  /**
+   * Find the k nearest neighbors of the points of the tree, each of which
+   * normally comes first among its own neighbors.
+   */
+  void Knn(int k, Indices& indices, Distances& dists)
+  {
+    KnnSearch(points_.Get(), k, indices, dists);
+  }
+
+  /**
+   * Find, for each query row, the points within a squared distance of
+   * squaredRadius.
+   */
+  template<typename Derived>
+  void Radius(const Eigen::DenseBase<Derived>& queries, double squaredRadius,
+              std::vector<std::vector<int>>& indices, std::vector<std::vector<double>>& dists)
+  {
+    FlannMatrix query(queries);
+    index_->radiusSearch(query.Get(), indices, dists, squaredRadius, flann::SearchParams(128));
+  }
+
+  /**
+   * Find the points within a squared distance of squaredRadius of each point
+   * of the tree.
+   */
+  void Radius(double squaredRadius, std::vector<std::vector<int>>& indices, std::vector<std::vector<double>>& dists)
+  {
+    index_->radiusSearch(points_.Get(), indices, dists, squaredRadius, flann::SearchParams(128));
+  }
+
+ private:
+  void KnnSearch(const flann::Matrix<double>& query, int k, Indices& indices, Distances& dists)
+  {
+    indices.resize(query.rows, k);
+    dists.resize(query.rows, k);
+    flann::Matrix<int> indicesOut(indices.data(), query.rows, k);
+    flann::Matrix<double> distsOut(dists.data(), query.rows, k);
+    index_->knnSearch(query, indicesOut, distsOut, k, flann::SearchParams(128));
+  }
+
+  // Declared first, since the index reads them
+  FlannMatrix points_;
+  std::unique_ptr<flann::Index<flann::L2<double>>> index_;
+};
+
+} // namespace utils
+} // namespace rlfd
+
+#endif // __KD_TREE_HH__
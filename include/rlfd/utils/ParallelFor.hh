@@ -0,0 +1,100 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#ifndef __PARALLELFOR_HH__
+#define __PARALLELFOR_HH__
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+namespace rlfd {
+namespace utils {
+
+/**
+ * @return The number of threads to use when 0 is requested: one per core.
+ */
+inline unsigned ThreadCount(unsigned nthreads)
+{
+  if (nthreads == 0) {
+    nthreads = std::thread::hardware_concurrency();
+  }
+  return nthreads > 0 ? nthreads : 1;
+}
+
+/**
+ * Call f(i) for every i in [0, count) over a pool of worker threads.
+ * Work items are handed out one at a time, so that items of uneven cost are
+ * balanced across the workers. The first exception thrown by a worker is
+ * rethrown in the calling thread.
+ * @param count The number of work items
+ * @param nthreads The number of workers. 0 means one per core.
+ * @param f The function to apply on each work item
+ */
+template<typename Function>
+void ParallelFor(size_t count, unsigned nthreads, Function f)
+{
+  nthreads = std::min<size_t>(ThreadCount(nthreads), count);
+  if (nthreads <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      f(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  std::exception_ptr error;
+  std::mutex errorMutex;
+
+  auto worker = [&]() {
+    size_t i;
+    while ((i = next++) < count) {
+      try {
+        f(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = count;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < nthreads; i++) {
+    workers.push_back(std::thread(worker));
+  }
+  worker();
+
+  for (auto& thread : workers) {
+    thread.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace utils
+} // namespace rlfd
+#endif // __PARALLELFOR_HH__
@@ -22,97 +22,237 @@
 
 #include <rlfd/utils/Matrixio.hh>
 
-#include <tuple>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
 #include <string>
 #include <vector>
-#include <sstream>
-#include <fstream>
-#include <iostream>
-#include <iterator>
-#include <algorithm>
 
 namespace rlfd {
 namespace utils {
 
+/**
+ * Whitespace-separated tables of numbers, one row per line. The input is
+ * parsed in place, one chunk at a time, so that the text is never held in
+ * memory as a whole.
+ */
 template<typename MatrixType=Eigen::MatrixXd>
 class Tabulario : public Matrixio<MatrixType>
 {
  public:
-  Tabulario() {};
-  virtual ~Tabulario() {};
+  Tabulario() : file_(NULL) {};
+  virtual ~Tabulario()
+  {
+    Close();
+  };
 
- private:
-  std::ifstream* file = nullptr;
+  void Open() throw(std::runtime_error)
+  {
+    /* Do nothing, stdin is always open */
+  }
 
-  void split_line(const std::string& line, std::vector<std::string>& words)
+  void Open(const std::string& filename) throw(std::runtime_error)
   {
-    std::istringstream iss(line);
-    std::copy(std::istream_iterator<std::string>(iss),
-              std::istream_iterator<std::string>(),
-              std::back_inserter<std::vector<std::string>>(words));
+    Close();
+    file_ = fopen(filename.c_str(), "r");
+    if (file_ == NULL) {
+      throw std::runtime_error(strerror(errno));
+    }
   }
 
-  std::tuple<int, int> get_dimensions(const std::vector<std::string>& lines)
+  void Read(MatrixType& out) throw(std::runtime_error)
   {
-    std::vector<std::string> cols;
-    split_line(lines[0], cols);
-    return std::make_tuple(lines.size(), cols.size());
+    FILE* in = file_ ? file_ : stdin;
+
+    std::vector<char> buffer(ChunkSize + 1);
+    std::vector<double> values;
+    int rows = 0;
+    int cols = -1;
+
+    size_t pending = 0;
+    bool eof = false;
+    while (!eof) {
+      size_t count = fread(buffer.data() + pending, 1, buffer.size() - 1 - pending, in);
+      if (count == 0) {
+        if (ferror(in)) {
+          throw std::runtime_error(strerror(errno));
+        }
+        eof = true;
+      }
+
+      // Only parse up to the last complete line, unless there is no more input
+      size_t length = pending + count;
+      buffer[length] = '\0';
+      size_t end = length;
+      if (!eof) {
+        while (end > 0 && buffer[end - 1] != '\n') {
+          end--;
+        }
+        if (end == 0) {
+          // A single line does not fit: keep reading into a larger buffer
+          pending = length;
+          if (pending == buffer.size() - 1) {
+            buffer.resize(2*buffer.size());
+          }
+          continue;
+        }
+      }
+
+      ParseLines(buffer.data(), buffer.data() + end, values, rows, cols);
+
+      pending = length - end;
+      memmove(buffer.data(), buffer.data() + end, pending);
+    }
+
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorType;
+    out = Eigen::Map<const RowMajorType>(values.data(), rows, cols < 0 ? 0 : cols).template cast<typename MatrixType::Scalar>();
   }
 
-  class Line {
-    std::string data;
-   public:
-    friend std::istream &operator>>(std::istream &is, Line &l) {
-      std::getline(is, l.data);
-      return is;
+  void Close(void) throw(std::runtime_error)
+  {
+    if (file_) {
+      fclose(file_);
+      file_ = NULL;
     }
-    operator std::string() const { return data; }
-  };
+  }
 
- public:
-  void Open() throw(std::runtime_error)
+ private:
+  static const size_t ChunkSize = 1 << 20;
+
+  static bool IsSpace(char c)
   {
-    /* Do nothing, std::cin is always open */
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
   }
 
-  void Open(const std::string& filename) throw(std::runtime_error)
+  static bool IsDigit(char c)
   {
-    file = new std::ifstream(filename, std::ifstream::in);
+    return c >= '0' && c <= '9';
   }
 
-  void Read(MatrixType& out) throw(std::runtime_error)
+  /**
+   * Parse the complete lines in [p, end) and append their values, row after
+   * row. Empty lines are skipped.
+   */
+  void ParseLines(const char* p, const char* end, std::vector<double>& values, int& rows, int& cols) throw(std::runtime_error)
   {
-    // Read all lines
-    std::vector<std::string> lines;
-    std::copy(std::istream_iterator<Line>(file ? *file: std::cin),
-              std::istream_iterator<Line>(),
-              std::back_inserter(lines));
-
-    // Find matrix dimensions
-    auto dims = get_dimensions(lines);
-    out.resize(std::get<0>(dims), std::get<1>(dims));
-
-    // Copy each element to the matrix
-    int i = 0;
-    for (auto line : lines) {
-      std::vector<std::string> tokens;
-      split_line(line, tokens);
-
-      int j = 0;
-      for (auto element : tokens) {
-        out(i, j) = std::stod(element);
-        j += 1;
+    int count = 0;
+    while (p < end) {
+      if (IsSpace(*p)) {
+        p++;
+      } else if (*p == '\n' || *p == '\0') {
+        EndRow(count, rows, cols);
+        count = 0;
+        p++;
+      } else {
+        double value;
+        const char* next = ParseDouble(p, value);
+        if (next == p || !(IsSpace(*next) || *next == '\n' || *next == '\0')) {
+          throw std::runtime_error("Invalid number on line " + std::to_string(rows + 1));
+        }
+        values.push_back(value);
+        count++;
+        p = next;
       }
-      i += 1;
     }
+    EndRow(count, rows, cols);
   }
 
-  void Close(void) throw(std::runtime_error)
+  void EndRow(int count, int& rows, int& cols) throw(std::runtime_error)
   {
-    if (file) {
-      file->close();
+    if (count == 0) {
+      return;
     }
+    if (cols < 0) {
+      cols = count;
+    } else if (count != cols) {
+      throw std::runtime_error("Expected " + std::to_string(cols) + " columns on line " +
+                               std::to_string(rows + 1) + ", found " + std::to_string(count));
+    }
+    rows++;
   }
+
+  /**
+   * Decimal numbers with at most 19 significant digits, whose value is exactly
+   * representable as mantissa * 10^exponent with mantissa < 2^53 and
+   * |exponent| <= 22, are converted with a single correctly rounded floating
+   * point operation. Anything else is left to strtod.
+   * @return A pointer past the last character of the number
+   */
+  static const char* ParseDouble(const char* p, double& value)
+  {
+    static const double powers[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* start = p;
+    bool negative = (*p == '-');
+    if (*p == '-' || *p == '+') {
+      p++;
+    }
+
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int digits = 0;
+    int exponent = 0;
+    for (; IsDigit(*p); p++, digits++) {
+      if (mantissa || *p != '0') {
+        if (significant++ < 19) {
+          mantissa = 10*mantissa + (*p - '0');
+        } else {
+          exponent++;
+        }
+      }
+    }
+    if (*p == '.') {
+      for (p++; IsDigit(*p); p++, digits++) {
+        if (mantissa || *p != '0') {
+          if (significant++ < 19) {
+            mantissa = 10*mantissa + (*p - '0');
+            exponent--;
+          }
+        } else {
+          exponent--;
+        }
+      }
+    }
+    if (digits > 0 && (*p == 'e' || *p == 'E')) {
+      const char* e = p + 1;
+      bool negativeExponent = (*e == '-');
+      if (*e == '-' || *e == '+') {
+        e++;
+      }
+      if (IsDigit(*e)) {
+        int explicitExponent = 0;
+        for (; IsDigit(*e); e++) {
+          if (explicitExponent < 100000) {
+            explicitExponent = 10*explicitExponent + (*e - '0');
+          }
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        p = e;
+      }
+    }
+
+    bool exact = (digits > 0 && significant <= 19 && mantissa <= (uint64_t(1) << 53) &&
+                  exponent >= -22 && exponent <= 22);
+    if (!exact || !(IsSpace(*p) || *p == '\n' || *p == '\0')) {
+      // Long mantissas, large exponents, infinities and NaNs
+      char* end;
+      value = strtod(start, &end);
+      return end;
+    }
+
+    value = (double) mantissa;
+    value = exponent < 0 ? value/powers[-exponent] : value*powers[exponent];
+    value = negative ? -value : value;
+    return p;
+  }
+
+  FILE* file_;
 };
 
 } // namespace utils
@@ -24,30 +24,80 @@
 #include <iostream>
 #include <limits>
 
+#include <getopt.h>
+
+void print_usage(void)
+{
+  std::cout << "Usage: autocorrelation [OPTION] [FILE]" << std::endl;
+  std::cout << "Compute the sample autocorrelation function of each column of the input, printed" << std::endl;
+  std::cout << "as the corresponding column of the output." << std::endl;
+  std::cout << "  -w, --window      compute short-time autocorrelations over sliding windows of" << std::endl;
+  std::cout << "                    this size instead. Requires a single column, and prints one" << std::endl;
+  std::cout << "                    column per window" << std::endl;
+  std::cout << "  -s, --step        the number of samples between consecutive windows. Default 1" << std::endl;
+  std::cout << "  -h, --help        display this help and exit" << std::endl;
+  std::cout << "\nAuthor: Pierre-Luc Bacon <pbacon@mail.mcgill.ca>" << std::endl;
+  std::cout << "Report bugs to: https://github.com/pierrelux/rlfd_segmentation" << std::endl;
+}
+
 int main(int argc, char** argv)
 {
-  if (argc > 2) {
-    std::cerr << "Compute the sample autocorrelation function" << std::endl; 
-    std::cerr << "Usage: autocorrelation [FILE]" << std::endl;
-    return -1;
+  int window = 0;
+  int step = 1;
+
+  // Parse arguments
+  static struct option long_options[] =
+  {
+    {"window", required_argument, 0, 'w'},
+    {"step", required_argument, 0, 's'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+  };
+
+  int option_index = 0;
+  int c;
+  while ((c = getopt_long(argc, argv, "w:s:h", long_options, &option_index)) != -1)
+  {
+    switch (c)
+    {
+      case 'w':
+        window = std::stoi(optarg);
+        break;
+      case 's':
+        step = std::stoi(optarg);
+        break;
+      case '?':
+      case 'h':
+      default:
+        print_usage();
+        return -1;
+    }
   }
 
   // Open up the .mat file. Version 7, and 7.3 are not supported and result in a
   // segmentation fault with the current version of libmatio in Ubuntu. 
   Eigen::MatrixXd ts;
-  if (argc == 2) {
-    rlfd::utils::Import(argv[2], ts);
+  if (optind < argc) {
+    rlfd::utils::Import(argv[optind], ts);
   } else {
     rlfd::utils::Import(ts);
   }
 
-  // Compute the autocorrelation coefficients 
-  Eigen::VectorXd acoeffs;
-  rlfd::utils::Autocorrelation(ts, acoeffs); 
+  // Compute the autocorrelation coefficients of all the columns or windows
+  // in batches
+  Eigen::MatrixXd acoeffs;
+  if (window > 0) {
+    if (ts.cols() != 1 || step <= 0) {
+      print_usage();
+      return -1;
+    }
+    rlfd::utils::SlidingAutocorrelation(ts.col(0), window, step, acoeffs);
+  } else {
+    rlfd::utils::Autocorrelations(ts, acoeffs);
+  }
 
   std::cout.precision(std::numeric_limits<double>::digits10);
   std::cout << acoeffs << std::endl;
 
   return 0;
 }
-
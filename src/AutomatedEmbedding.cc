@@ -34,6 +34,7 @@ void print_usage(void)
   std::cout << "  -L --max-lag            Maximum number of lags to compute in the average displacement method." << std::endl;
   std::cout << "  -M --max-dimension      Maximum dimension" << std::endl;
   std::cout << "  -n --nearest-neighbors  Number of nearest neighbors to compute in the gamma test." << std::endl;
+  std::cout << "  -j --threads            Number of dimensions evaluated concurrently. 0 means one per core." << std::endl;
 }
 
 int main(int argc, char** argv)
@@ -42,6 +43,7 @@ int main(int argc, char** argv)
   int max_dimension = 10;
   int max_lag = 50;
   int nn = 20;
+  unsigned threads = 1;
 
   // Parse arguments
   static struct option long_options[] =
@@ -49,13 +51,14 @@ int main(int argc, char** argv)
     {"help", no_argument, 0, 'h'},
     {"max-lag", required_argument, 0, 'L'},
     {"max-dimension", required_argument, 0, 'M'},
-    {"nearest-neighbors", no_argument, 0, 'n'},
+    {"nearest-neighbors", required_argument, 0, 'n'},
+    {"threads", required_argument, 0, 'j'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "hL:M:n:", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "hL:M:n:j:", long_options, &option_index)) != -1)
   {
     switch (c)
     {
@@ -68,6 +71,9 @@ int main(int argc, char** argv)
       case 'n':
         nn = std::stoi(optarg); 
         break;
+      case 'j':
+        threads = std::stoi(optarg);
+        break;
       case 'h':
       default:
         print_usage();
@@ -87,6 +93,6 @@ int main(int argc, char** argv)
 
   // Print the sm statistics
   std::cout.precision(std::numeric_limits<double>::digits10);
-  std::cout << rlfd::delay::AutomatedEmbedding(ts, max_lag, max_dimension, nn) << std::endl; 
+  std::cout << rlfd::delay::AutomatedEmbedding(ts, max_lag, max_dimension, nn, threads) << std::endl; 
   return 0;
 }
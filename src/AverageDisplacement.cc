@@ -33,6 +33,7 @@ void print_usage(void)
   std::cerr << "  -m --dimension    Embedding dimension" << std::endl;
   std::cerr << "  -n --nlags        Number of lags to compute." << std::endl;
   std::cerr << "  -s --squared      Compute the average squared using the sample autocorrelation function" << std::endl;
+  std::cerr << "  -r --rms          Bound the statistics from above by the root mean square displacement, using the FFT" << std::endl;
 }
 
 int main(int argc, char** argv)
@@ -41,6 +42,7 @@ int main(int argc, char** argv)
   int embedding_dimension = 2;
   int lag = 20;
   bool squared = false;
+  bool rms = false;
 
   // Parse arguments
   static struct option long_options[] =
@@ -48,12 +50,13 @@ int main(int argc, char** argv)
     {"dimension", required_argument, 0, 'm'},
     {"nlags", required_argument, 0, 'n'},
     {"squared", no_argument, 0, 's'},
+    {"rms", no_argument, 0, 'r'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "m:n:s", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "m:n:sr", long_options, &option_index)) != -1)
   {
     switch (c)
     {
@@ -66,6 +69,9 @@ int main(int argc, char** argv)
       case 's':
         squared = true;
         break;
+      case 'r':
+        rms = true;
+        break;
       default:
         print_usage();
         return -1;
@@ -86,6 +92,9 @@ int main(int argc, char** argv)
   if (squared) {
     std::cout << "# Squared average displacement statistics" << std::endl;
     ads = rlfd::delay::SquaredAverageDisplacement(ts, embedding_dimension, lag);
+  } else if (rms) {
+    std::cout << "# Root mean square displacement statistics" << std::endl;
+    ads = rlfd::delay::AverageDisplacementBound(ts, embedding_dimension, lag);
   } else {
     std::cout << "# Average displacement statistics" << std::endl;
     ads = rlfd::delay::AverageDisplacement(ts, embedding_dimension, lag);
@@ -17,10 +17,13 @@
  * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
  * Boston, MA  02110-1301, USA.
  */
+#include <rlfd/utils/KdTree.hh>
+#include <rlfd/utils/IndexCache.hh>
 #include <rlfd/utils/ImportExport.hh>
 
+#include <string>
+#include <iostream>
 #include <Eigen/Core>
-#include <flann/flann.hpp>
 
 #include <getopt.h>
 
@@ -29,21 +32,30 @@ void print_usage(void)
   std::cout << "Build a Kd-Tree index for the input data using libflann" << std::endl;
   std::cout << "Usage: build-kdtree [OPTION] [FILE]" << std::endl;
   std::cout << "FILE is the mandatory output filename. The data to embed is expected to be received from STDIN." << std::endl;
+  std::cout << "  -c --cache  Save the index in this cache directory instead of FILE, unless" << std::endl;
+  std::cout << "              it is already there, for getem --cache to find it. FILE must then" << std::endl;
+  std::cout << "              be omitted." << std::endl;
 }
 
 int main(int argc, char** argv)
 {
+  std::string cache;
+
   static struct option long_options[] =
   {
+    {"cache", required_argument, 0, 'c'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "c:", long_options, &option_index)) != -1)
   {
     switch (c)
     {
+      case 'c':
+        cache = optarg;
+        break;
       default:
         print_usage();
         return -1;
@@ -51,26 +63,34 @@ int main(int argc, char** argv)
   }
 
   // Treat the non-option as the FILE argument
-  if (optind >= argc) {
+  if (optind >= argc && cache == "") {
     std::cerr << "The output FILE argument must be provided.\n" << std::endl;
     print_usage();
     return -1;
   }
+  if (optind < argc && cache != "") {
+    std::cerr << "The output FILE argument cannot be given with --cache.\n" << std::endl;
+    print_usage();
+    return -1;
+  }
 
   // Read from stdin
   Eigen::MatrixXd in;
   rlfd::utils::Import(in);
 
-  flann::Matrix<double> input(new double[in.rows()*in.cols()], in.rows(), in.cols());
-  for (int i = 0; i  < in.rows(); i++) {
-    for (int j = 0; j < in.cols(); j++) {
-      input[i][j] = in(i, j);
+  if (cache != "") {
+    try {
+      rlfd::utils::IndexCache indexes(cache);
+      indexes.Get(in);
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return -1;
     }
+    return 0;
   }
 
-  flann::Index<flann::L2<double> > index(input, flann::KDTreeSingleIndexParams());
-  index.buildIndex();
-  index.save(argv[optind]);
+  rlfd::utils::KdTree index(in);
+  index.Save(argv[optind]);
 
   return 0;
 }
@@ -31,8 +31,11 @@ void print_usage(void)
 {
   std::cout << "Usage: C-Segmentation [OPTION]" << std::endl;
   std::cout << "Execute the C-Segmentation algorithm on the data passed through STDIN" << std::endl;
-  std::cout << "  -D, --distance-matrix  a file containing the pre-computed all-pairs distances" << std::endl;
+  std::cout << "  -D, --distance-matrix  a file containing the pre-computed all-pairs distances," << std::endl;
+  std::cout << "                         either as text or as a tiled store from gaussiankde --tiled" << std::endl;
   std::cout << "  -C, --regularizer      the regularization constant that penalizes changes of state" << std::endl;
+  std::cout << "  -p, --change-points    print the times at which the state changes, followed by the" << std::endl;
+  std::cout << "                         new state, instead of the state at every time" << std::endl;
   std::cout << "  -h, --help             display this help and exit" << std::endl;
   std::cout << "\n\nFrom:\nJ. Kohlmorgen, \"On Optimal Segmentation of Sequential Data\", in" << std::endl;
   std::cout << "Proceedings of the 13th International IEEE workshop on Neural Networks for" << std::endl;
@@ -51,19 +54,21 @@ int main(int argc, char** argv)
 
   double regularizer = 0.0;
   std::string distance_file;
+  int change_points_flag = 0;
 
   // Parse arguments
   static struct option long_options[] =
   {
     {"distance-matrix", required_argument, 0, 'D'},
     {"regularizer", required_argument, 0, 'C'},
+    {"change-points", no_argument, 0, 'p'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "C:D:h", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "C:D:ph", long_options, &option_index)) != -1)
   {
     switch (c)
     {
@@ -73,6 +78,9 @@ int main(int argc, char** argv)
       case 'D':
         distance_file = std::string(optarg);
         break;
+      case 'p':
+        change_points_flag = 1;
+        break;
       case '?':
       case 'h':
       default:
@@ -81,14 +89,36 @@ int main(int argc, char** argv)
     }
   }
 
-  // Read the distance matrix
-  Eigen::MatrixXd dists;
-  if (distance_file != "") {
-    rlfd::utils::Import(distance_file, dists);
+  // Compute the segmentation, reading the distances from a tiled store one
+  // panel at a time, or mapping binary distance matrices in place
+  Eigen::VectorXi states;
+  double cost;
+  if (distance_file != "" && rlfd::utils::DistanceStore::IsStore(distance_file)) {
+    rlfd::utils::DistanceStore store;
+    store.Open(distance_file);
+    cost = rlfd::segment::CSegmentation(store, regularizer, states);
+  } else if (distance_file != "" && rlfd::utils::Binaryio<>::IsBinary(distance_file)) {
+    rlfd::utils::Binaryio<> binary;
+    binary.Open(distance_file);
+    cost = rlfd::segment::CSegmentation(binary.Map(), regularizer, states);
+  } else {
+    Eigen::MatrixXd dists;
+    if (distance_file != "") {
+      rlfd::utils::Import(distance_file, dists);
+    }
+    cost = rlfd::segment::CSegmentation(dists, regularizer, states);
   }
+  std::cerr << "Cost of the optimal path: " << cost << std::endl;
 
-  // Compute the segmentation
-  rlfd::segment::CSegmentation(dists, regularizer);
+  if (change_points_flag) {
+    Eigen::VectorXi changes;
+    rlfd::segment::ChangePoints(states, changes);
+    for (int i = 0; i < changes.size(); i++) {
+      std::cout << changes[i] << " " << states[changes[i]] << std::endl;
+    }
+  } else {
+    std::cout << states << std::endl;
+  }
 
   return 0;
 }
@@ -30,9 +30,12 @@
 void print_usage(void)
 {
   std::cout << "Usage: delay-embedding [OPTION] [FILE]" << std::endl;
-  std::cout << "Transform a scalar time series into delay vectors of dimension m." << std::endl;
-  std::cout << "  -m, --dimension    the embedding dimension" << std::endl;
-  std::cout << "  -d, --delay        the lag value" << std::endl;
+  std::cout << "Transform a time series into delay vectors. Each column is a channel, and the" << std::endl;
+  std::cout << "delay vectors of all the channels are concatenated." << std::endl;
+  std::cout << "  -m, --dimension    the embedding dimension, or a comma-separated one per channel" << std::endl;
+  std::cout << "  -d, --delay        the lag value, or a comma-separated one per channel" << std::endl;
+  std::cout << "  -o, --output       write the delay vectors to this file instead of STDOUT. Binary" << std::endl;
+  std::cout << "                     if it ends with .bin, tabular text otherwise" << std::endl;
   std::cout << "  -h, --help        display this help and exit" << std::endl;
   std::cout << "\nAuthor: Pierre-Luc Bacon <pbacon@mail.mcgill.ca>" << std::endl;
   std::cout << "Report bugs to: https://github.com/pierrelux/rlfd_segmentation" << std::endl;
@@ -40,29 +43,34 @@ void print_usage(void)
 
 int main(int argc, char** argv)
 {
-  int embedding_dimension = 2;
-  int lag = 1;
+  std::string embedding_dimension = "2";
+  std::string lag = "1";
+  std::string output_file;
 
   // Parse arguments
   static struct option long_options[] =
   {
     {"dimension", required_argument, 0, 'm'},
     {"delay", required_argument, 0, 'd'},
+    {"output", required_argument, 0, 'o'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "m:d:h", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "m:d:o:h", long_options, &option_index)) != -1)
   {
     switch (c)
     {
       case 'm' :
-        embedding_dimension = std::stoi(optarg);
+        embedding_dimension = std::string(optarg);
         break;
       case 'd' :
-        lag = std::stoi(optarg);
+        lag = std::string(optarg);
+        break;
+      case 'o':
+        output_file = std::string(optarg);
         break;
       case '?':
       case 'h':
@@ -82,9 +90,19 @@ int main(int argc, char** argv)
 
   // Delay embedding
   Eigen::MatrixXd out;
-  rlfd::delay::DelayEmbedding::Embed(ts, embedding_dimension, lag, out);
-  std::cout.precision(std::numeric_limits<double>::digits10);
-  std::cout << out << std::endl;
+  try {
+    rlfd::delay::DelayEmbedding::Embed(ts, rlfd::delay::ChannelParameters(embedding_dimension, ts.cols()),
+                                       rlfd::delay::ChannelParameters(lag, ts.cols()), out);
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    print_usage();
+    return -1;
+  }
+  if (output_file != "") {
+    rlfd::utils::Export(output_file, out);
+  } else {
+    rlfd::utils::Export(out);
+  }
 
   return 0;
 }
@@ -18,6 +18,7 @@
  * Boston, MA  02110-1301, USA.
  */
 #include <rlfd/delay/GammaTest.hh>
+#include <rlfd/delay/IncrementalGammaTest.hh>
 #include <rlfd/utils/ImportExport.hh>
 
 #include <limits>
@@ -31,29 +32,43 @@ void print_usage(void)
     std::cerr << "Usage: gamma-test [OPTION] [FILE]" << std::endl;
     std::cerr << "  -n --nearest-neighbor  The number of nearest neighbors over which to" << std::endl;
     std::cerr << "                         compute the gamma-test statistics." << std::endl;
+    std::cerr << "  -m --dimension         Test the delay vectors of the first column instead, for" << std::endl;
+    std::cerr << "                         each embedding dimension up to this one." << std::endl;
+    std::cerr << "  -l --lag               The lag of the delay vectors." << std::endl;
     std::cerr << "The last column is assumed to be the scalar output time series y." << std::endl;
+    std::cerr << "With -m, one line of statistics is printed per embedding dimension." << std::endl;
 }
 
 int main(int argc, char** argv)
 {
   int nn = 20;
+  int max_dimension = 0;
+  int lag = 1;
 
   // Parse arguments
   static struct option long_options[] =
   {
     {"nearest-neighbor", required_argument, 0, 'n'},
+    {"dimension", required_argument, 0, 'm'},
+    {"lag", required_argument, 0, 'l'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "n:", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "n:m:l:", long_options, &option_index)) != -1)
   {
     switch (c)
     {
       case 'n' :
         nn = std::stoi(optarg);
         break;
+      case 'm':
+        max_dimension = std::stoi(optarg);
+        break;
+      case 'l':
+        lag = std::stoi(optarg);
+        break;
       default:
         print_usage();
         return -1;
@@ -70,5 +85,18 @@ int main(int argc, char** argv)
 
   // Compute the gamma test
   std::cout.precision(std::numeric_limits<double>::digits10);
+  if (max_dimension > 0) {
+    // Nearest neighbors carry over from one dimension to the next
+    rlfd::delay::IncrementalGammaTest gamma(ts.col(0), lag, nn);
+    try {
+      for (int m = 1; m <= max_dimension; m++) {
+        std::cout << gamma.Next().transpose() << std::endl;
+      }
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return -1;
+    }
+    return 0;
+  }
   std::cout << rlfd::delay::GammaTest(ts.leftCols(ts.cols()-1), ts.rightCols(1), nn) << std::endl;
 }
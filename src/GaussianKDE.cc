@@ -18,9 +18,13 @@
  * Boston, MA  02110-1301, USA.
  */
 #include <rlfd/utils/ImportExport.hh>
+#include <rlfd/utils/DistanceStore.hh>
 #include <rlfd/stats/GaussianDensityEstimator.hh>
+#include <rlfd/stats/RandomFourierDensityEstimator.hh>
 
 #include <limits>
+#include <random>
+#include <chrono>
 #include <iostream>
 
 #include <getopt.h>
@@ -32,8 +36,25 @@ void print_usage(void)
   std::cout << "Compute the full distance matrix between all pair of points." << std::endl;
   std::cout << "  -w, --window      the window size in which the PDF should be estimated" << std::endl;
   std::cout << "  -s, --sigma       the sigma constant in the expression of the Gaussian density" << std::endl;
+  std::cout << "  -j, --threads     the number of threads used to compute the distances. 0 uses all cores" << std::endl;
+  std::cout << "  -b, --backend     how to compute the kernel sums: incremental (default), gemm, truncated," << std::endl;
+  std::cout << "                    pairwise, which sums each pair of windows with the --summation method," << std::endl;
+  std::cout << "                    or fourier, which approximates them with random Fourier features" << std::endl;
+  std::cout << "  -k, --summation   how the kernel terms between two windows are summed by the pairwise" << std::endl;
+  std::cout << "                    backend: exact (default), ifgt or dualtree" << std::endl;
+  std::cout << "  -F, --features    the number of random features of the fourier backend. Default 1024" << std::endl;
+  std::cout << "  -e, --tolerance   the error allowed in each distance by the truncated backend, and per" << std::endl;
+  std::cout << "                    kernel term by the ifgt and dualtree summations. Defaults to 1e-12 for" << std::endl;
+  std::cout << "                    the former, which sums about W^2 terms per distance, and 1e-6 for the" << std::endl;
+  std::cout << "                    latter, as kohlmorgen-lemm does" << std::endl;
+  std::cout << "  -t, --tiled       write the distances to this tiled store instead of STDOUT, without" << std::endl;
+  std::cout << "                    holding the whole matrix in memory" << std::endl;
+  std::cout << "  -o, --output      write the distances to this file instead of STDOUT. Binary if" << std::endl;
+  std::cout << "                    it ends with .bin, tabular text otherwise" << std::endl;
   std::cout << "  -h, --help        display this help and exit" << std::endl;
   std::cout << "      --calibrate   estimate the appropriate value for the sigma parameter" << std::endl;
+  std::cout << "      --benchmark   compare the error and throughput of the kernel summation methods" << std::endl;
+  std::cout << "                    on random pairs of windows instead of computing the distances" << std::endl;
   std::cout << "\n\nFrom:\nJ. Kohlmorgen, \"On Optimal Segmentation of Sequential Data\", in" << std::endl;
   std::cout << "Proceedings of the 13th International IEEE workshop on Neural Networks for" << std::endl;
   std::cout << "Signal Processing, 2003, pp. 449–458." << std::endl;
@@ -41,6 +62,78 @@ void print_usage(void)
   std::cout << "Report bugs to: https://github.com/pierrelux/rlfd_segmentation" << std::endl;
 }
 
+/**
+ * Write the distance matrix to a tiled store, a file or STDOUT.
+ */
+template<typename Estimator>
+void WriteDistances(Estimator& kde, const Eigen::MatrixXd& ts, int W, unsigned threads,
+                    const std::string& tiled_file, const std::string& output_file)
+{
+  unsigned T = ts.rows();
+  if (tiled_file != "") {
+    rlfd::utils::DistanceStore store;
+    store.Create(tiled_file, T-W, rlfd::stats::GaussianDensityEstimator::GetTileSize());
+    kde.DistanceTiles(ts, W, [&](int s0, int t0, const Eigen::MatrixXd& tile) {
+      store.WriteTile(s0, t0, tile);
+    }, threads);
+    store.Close();
+  } else {
+    Eigen::MatrixXd distances(T-W, T-W);
+    distances.setZero();
+    kde.DistanceMatrix(ts, W, distances, threads);
+    if (output_file != "") {
+      rlfd::utils::Export(output_file, distances);
+    } else {
+      rlfd::utils::Export(distances);
+    }
+  }
+}
+
+/**
+ * Sum the kernel terms of random pairs of windows with every summation method
+ * and report their throughput and their relative error against exact sums.
+ */
+void Benchmark(const Eigen::MatrixXd& ts, int W, double sigma, double tolerance)
+{
+  typedef rlfd::stats::KernelSummation::Method Method;
+  const int Pairs = 200;
+
+  rlfd::stats::GaussianDensityEstimator kde(sigma, ts.cols());
+  const double k = kde.GetKernelFactor();
+
+  std::mt19937 generator(0);
+  std::uniform_int_distribution<int> start(0, ts.rows() - W);
+  std::vector<std::pair<Eigen::MatrixXd, Eigen::MatrixXd>> windows;
+  for (int i = 0; i < Pairs; i++) {
+    windows.push_back(std::make_pair(ts.block(start(generator), 0, W, ts.cols()).eval(),
+                                     ts.block(start(generator), 0, W, ts.cols()).eval()));
+  }
+
+  std::vector<double> exact;
+  std::cout << "method      pairs/s        max relative error" << std::endl;
+  for (auto method : {Method::Exact, Method::Ifgt, Method::DualTree}) {
+    rlfd::stats::KernelSummation summation(method, tolerance);
+    std::vector<double> sums;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (const auto& pair : windows) {
+      sums.push_back(summation.Sum(pair.first, pair.second, k));
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    if (method == Method::Exact) {
+      exact = sums;
+    }
+    double error = 0.0;
+    for (int i = 0; i < Pairs; i++) {
+      error = std::max(error, std::abs(sums[i] - exact[i])/exact[i]);
+    }
+
+    const char* names[] = {"exact", "ifgt", "dualtree"};
+    std::cout << names[(int) method] << "\t    " << Pairs/elapsed << "\t   " << error << std::endl;
+  }
+}
+
 int main(int argc, char** argv)
 {
   if (argc == 1) {
@@ -52,21 +145,38 @@ int main(int argc, char** argv)
 
   int W = 50;
   double sigma = 1.0;
+  unsigned threads = 1;
+  std::string backend = "incremental";
+  double tolerance = 1e-12;
+  double term_tolerance = 1e-6;
+  int features = 1024;
+  std::string tiled_file;
+  std::string output_file;
+  std::string summation = "exact";
   int calibrate_flag = 0;
+  int benchmark_flag = 0;
 
   // Parse arguments
   static struct option long_options[] =
   {
     {"calibrate", no_argument, &calibrate_flag, 1},
+    {"benchmark", no_argument, &benchmark_flag, 1},
     {"window", required_argument, 0, 'w'},
     {"sigma", required_argument, 0, 's'},
+    {"threads", required_argument, 0, 'j'},
+    {"backend", required_argument, 0, 'b'},
+    {"summation", required_argument, 0, 'k'},
+    {"tolerance", required_argument, 0, 'e'},
+    {"features", required_argument, 0, 'F'},
+    {"tiled", required_argument, 0, 't'},
+    {"output", required_argument, 0, 'o'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "w:s:h", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "w:s:j:b:k:e:F:t:o:h", long_options, &option_index)) != -1)
   {
     switch (c)
     {
@@ -78,6 +188,28 @@ int main(int argc, char** argv)
       case 's':
         sigma = std::stod(optarg);
         break;
+      case 'j':
+        threads = std::stoul(optarg);
+        break;
+      case 'b':
+        backend = std::string(optarg);
+        break;
+      case 'k':
+        summation = std::string(optarg);
+        break;
+      case 'e':
+        tolerance = std::stod(optarg);
+        term_tolerance = tolerance;
+        break;
+      case 'F':
+        features = std::stoi(optarg);
+        break;
+      case 't':
+        tiled_file = std::string(optarg);
+        break;
+      case 'o':
+        output_file = std::string(optarg);
+        break;
       case '?':
       case 'h':
       default:
@@ -104,17 +236,45 @@ int main(int argc, char** argv)
     return 0;
   }
 
-  // Default behavior: compute distance matrix
-  rlfd::stats::GaussianDensityEstimator kde(sigma, ts.cols());
+  if (benchmark_flag) {
+    Benchmark(ts, W, sigma, term_tolerance);
+    return 0;
+  }
 
-  unsigned T = ts.rows();
-  Eigen::MatrixXd distances(T-W, T-W);
-  distances.setZero();
+  // Default behavior: compute distance matrix
   std::cerr << "Computing distances..." << std::endl;
+  if (backend == "fourier") {
+    rlfd::stats::RandomFourierDensityEstimator rff(sigma, ts.cols(), features);
+    WriteDistances(rff, ts, W, threads, tiled_file, output_file);
+    return 0;
+  }
+
+  rlfd::stats::GaussianDensityEstimator kde(sigma, ts.cols());
+  kde.SetTolerance(tolerance);
+  try {
+    kde.SetSummation(rlfd::stats::KernelSummation(rlfd::stats::KernelSummation::ParseMethod(summation), term_tolerance));
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    print_usage();
+    return -1;
+  }
+  if (backend == "gemm") {
+    kde.SetBackend(rlfd::stats::GaussianDensityEstimator::Backend::Gemm);
+  } else if (backend == "truncated") {
+    kde.SetBackend(rlfd::stats::GaussianDensityEstimator::Backend::Truncated);
+  } else if (backend == "pairwise") {
+    kde.SetBackend(rlfd::stats::GaussianDensityEstimator::Backend::Pairwise);
+  } else if (backend != "incremental") {
+    std::cerr << "Unknown backend " << backend << std::endl;
+    print_usage();
+    return -1;
+  }
 
-  kde.DistanceMatrix(ts, W, distances);
+  WriteDistances(kde, ts, W, threads, tiled_file, output_file);
 
-  std::cout << distances << std::endl;
+  if (kde.GetBackend() == rlfd::stats::GaussianDensityEstimator::Backend::Truncated) {
+    std::cerr << "Pruning ratio: " << kde.GetPruningRatio() << " of the kernel terms evaluated" << std::endl;
+  }
 
   return 0;
 }
@@ -22,6 +22,7 @@
 #include <rlfd/delay/DelayEmbedding.hh>
 #include <rlfd/delay/GeometricTemplateMatching.hh>
 
+#include <string>
 #include <limits>
 #include <iostream>
 
@@ -40,7 +41,9 @@ of the base models and the similarity scores sent to STDOUT.\n\
 \n\
 Usage: getem [OPTION] [DIR]\n\
   -s  --segment-length    Segment length. Default 32\n\
-  -n  --nearest-neighbor  Number of nearest neighbors. Default 4" << std::endl;
+  -n  --nearest-neighbor  Number of nearest neighbors. Default 4\n\
+  -c  --cache             Directory where the index of the base model is kept\n\
+                          between runs, and rebuilt when the model changes" << std::endl;
 }
 
 int main(int argc, char** argv)
@@ -48,18 +51,20 @@ int main(int argc, char** argv)
   // Default values
   int segment_length = 32;
   int nearest_neighbor = 4;
+  std::string cache;
 
   // Parse arguments
   static struct option long_options[] =
   {
     {"segment-length", required_argument, 0, 's'},
     {"nearest-neighbor", required_argument, 0, 'n'},
+    {"cache", required_argument, 0, 'c'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "s:n:", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "s:n:c:", long_options, &option_index)) != -1)
   {
     switch (c)
     {
@@ -69,6 +74,9 @@ int main(int argc, char** argv)
       case 'n':
         nearest_neighbor = std::stoi(optarg);
         break;
+      case 'c':
+        cache = optarg;
+        break;
       default:
         print_usage();
         return -1;
@@ -92,7 +100,17 @@ int main(int argc, char** argv)
 
   rlfd::delay::DelayEmbedding model;
   model.SetMatrix(modelEmb);
-  model.BuildIndex();
+  if (cache != "") {
+    try {
+      rlfd::utils::IndexCache indexes(cache);
+      model.BuildIndex(indexes);
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return -1;
+    }
+  } else {
+    model.BuildIndex();
+  }
 
   Eigen::VectorXd r;
   rlfd::delay::GeometricTemplateMatching(model, testEmb, r, segment_length, nearest_neighbor);
@@ -82,7 +82,12 @@ int main(int argc, char** argv)
 
   // Delay embedding
   std::cout.precision(std::numeric_limits<double>::digits10);
-  std::cout << rlfd::delay::IncreasingEmbedding(ts, lag, embedding_dimension, nn) << std::endl;
+  try {
+    std::cout << rlfd::delay::IncreasingEmbedding(ts, lag, embedding_dimension, nn) << std::endl;
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
 
   return 0;
 }
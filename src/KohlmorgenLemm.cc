@@ -19,11 +19,12 @@
  */
 #include <rlfd/utils/ImportExport.hh>
 #include <rlfd/delay/DelayEmbedding.hh>
-#include <rlfd/segment/CSegmentation.hh>
+#include <rlfd/delay/StreamingEmbedding.hh>
 #include <rlfd/segment/KohlmorgenLemm.hh>
 #include <rlfd/stats/GaussianDensityEstimator.hh>
 
 #include <limits>
+#include <vector>
 #include <iostream>
 
 #include <getopt.h>
@@ -32,19 +33,49 @@
 void print_usage(void)
 {
   std::cout << "Execute the Kohlmorgen-Lemm algorithm on the data passed through STDIN" << std::endl;
-  std::cout << "Usage: kolmorgen-lemm [OPTION]" << std::endl;
-  std::cout << "  -m --dimension    The Embedding dimension." << std::endl;
-  std::cout << "  -d --delay        The lag value." << std::endl;
+  std::cout << "Usage: kolmorgen-lemm [OPTION] [FILE]" << std::endl;
+  std::cout << "  -m --dimension    The Embedding dimension, or a comma-separated one per channel." << std::endl;
+  std::cout << "  -d --delay        The lag value, or a comma-separated one per channel." << std::endl;
+  std::cout << "  -W --window       The window size." << std::endl;
+  std::cout << "  -C --regularizer  The regularization constant that penalizes changes of state." << std::endl;
+  std::cout << "  -s --sigma        The kernel bandwidth. Estimated from the data when omitted." << std::endl;
+  std::cout << "  -H --horizon      The number of past windows over which a new state is evaluated," << std::endl;
+  std::cout << "                    which also bounds the number of states. Default 10 W. It bounds" << std::endl;
+  std::cout << "                    the memory and the time per sample, but approximates the" << std::endl;
+  std::cout << "                    segmentation. 0 runs the exact algorithm, which keeps the whole" << std::endl;
+  std::cout << "                    input and every state, and reports every change at the end." << std::endl;
+  std::cout << "  -l --lifetime     The number of steps a state may cost more than the optimum plus" << std::endl;
+  std::cout << "                    C before it is dropped. Default -1, the horizon, or every state" << std::endl;
+  std::cout << "                    is kept with -H 0. Dropping states is an approximation which may" << std::endl;
+  std::cout << "                    change the segmentation." << std::endl;
+  std::cout << "  -n --max-states   The maximal number of active states, an approximation as well." << std::endl;
+  std::cout << "                    Default 0, the horizon, or no limit with -H 0." << std::endl;
+  std::cout << "  -k --summation    How the kernel terms of whole windows are summed when the" << std::endl;
+  std::cout << "                    running sums are refreshed: exact (default), ifgt or dualtree." << std::endl;
+  std::cout << "  -e --tolerance    The error per kernel term of ifgt and dualtree. Default 1e-6, as" << std::endl;
+  std::cout << "                    for the summations of gaussiankde." << std::endl;
+  std::cout << "  -h --help         Display this help and exit." << std::endl;
+  std::cout << "\nEach column of the input is a channel, and all the channels are segmented" << std::endl;
+  std::cout << "jointly from their concatenated delay vectors." << std::endl;
+  std::cout << "The samples are processed one at a time. Each change of state is printed as" << std::endl;
+  std::cout << "the first window of the new segment followed by its state, as soon as it is" << std::endl;
+  std::cout << "certain. With -H 0, this is only known at the end of the input." << std::endl;
 }
 
 int main(int argc, char** argv)
 {
   std::cout.precision(std::numeric_limits<double>::digits10);
 
-  int embedding_dimension = 2;
-  int lag = 1;
+  std::string embedding_dimension = "2";
+  std::string lag = "1";
   double W = 50;
   double regularizer = 0;
+  double sigma = 0;
+  int horizon = -1;
+  int lifetime = -1;
+  unsigned max_states = 0;
+  std::string summation = "exact";
+  double tolerance = 1e-6;
 
   // Parse arguments
   static struct option long_options[] =
@@ -53,20 +84,27 @@ int main(int argc, char** argv)
     {"delay", required_argument, 0, 'd'},
     {"regularizer", required_argument, 0, 'C'},
     {"window", required_argument, 0, 'W'},
+    {"sigma", required_argument, 0, 's'},
+    {"horizon", required_argument, 0, 'H'},
+    {"lifetime", required_argument, 0, 'l'},
+    {"max-states", required_argument, 0, 'n'},
+    {"summation", required_argument, 0, 'k'},
+    {"tolerance", required_argument, 0, 'e'},
+    {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "m:d:C:W:", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "m:d:C:W:s:H:l:n:k:e:h", long_options, &option_index)) != -1)
   {
     switch (c)
     {
       case 'm' :
-        embedding_dimension = std::stoi(optarg);
+        embedding_dimension = std::string(optarg);
         break;
       case 'd' :
-        lag = std::stoi(optarg);
+        lag = std::string(optarg);
         break;
       case 'C' :
         regularizer = std::stod(optarg);
@@ -74,6 +112,25 @@ int main(int argc, char** argv)
       case 'W':
         W = std::stoi(optarg);
         break;
+      case 's':
+        sigma = std::stod(optarg);
+        break;
+      case 'H':
+        horizon = std::stoi(optarg);
+        break;
+      case 'l':
+        lifetime = std::stoi(optarg);
+        break;
+      case 'n':
+        max_states = std::stoul(optarg);
+        break;
+      case 'k':
+        summation = std::string(optarg);
+        break;
+      case 'e':
+        tolerance = std::stod(optarg);
+        break;
+      case 'h':
       default:
         print_usage();
         return -1;
@@ -82,31 +139,69 @@ int main(int argc, char** argv)
 
   Eigen::MatrixXd ts;
   if (optind < argc) {
-    std::cout << "Importing from file" << std::endl;
     rlfd::utils::Import(argv[optind], ts);
   } else {
     // Read from stdin
     rlfd::utils::Import(ts);
   }
 
-  // Embed the input points
-  Eigen::MatrixXd embTs;
-  rlfd::delay::DelayEmbedding::Embed(ts, embedding_dimension, lag, embTs);
+  Eigen::VectorXi m, lags;
+  try {
+    m = rlfd::delay::ChannelParameters(embedding_dimension, ts.cols());
+    lags = rlfd::delay::ChannelParameters(lag, ts.cols());
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    print_usage();
+    return -1;
+  }
+  rlfd::delay::StreamingEmbedding embedding(m, lags);
 
   // Estimate the sigma parameter for KDE
-  rlfd::stats::GaussianDensityEstimator kde;
-  kde.Calibrate(embTs);
-  std::cout << "Sigma : " << kde.GetSigma() << std::endl;
-  std::cout << "d: " << kde.GetDimensionality() << std::endl;
-  std::cout << "W: " << W << std::endl;
+  rlfd::stats::GaussianDensityEstimator kde(sigma, embedding.GetDimension());
+  if (sigma <= 0) {
+    Eigen::MatrixXd embTs;
+    rlfd::delay::DelayEmbedding::Embed(ts, m, lags, embTs);
+    kde.Calibrate(embTs);
+  }
+  try {
+    kde.SetSummation(rlfd::stats::KernelSummation(rlfd::stats::KernelSummation::ParseMethod(summation), tolerance));
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    print_usage();
+    return -1;
+  }
+  std::cerr << "Sigma : " << kde.GetSigma() << std::endl;
+  std::cerr << "d: " << kde.GetDimensionality() << std::endl;
+  std::cerr << "W: " << W << std::endl;
 
-  //rlfd::segment::KohlmorgenLemm<rlfd::stats::GaussianDensityEstimator> segmenter(kde, W, regularizer);
-  //for (int t = W; t < embTs.rows(); t++) {
-  //  segmenter.AddObservation(embTs, t);
-  //}
+  // Embed and feed the samples one at a time
+  rlfd::segment::KohlmorgenLemm segmenter(kde, W, regularizer);
+  if (horizon >= 0) {
+    segmenter.SetHorizon(horizon);
+  }
+  segmenter.SetLifetime(lifetime);
+  segmenter.SetMaxStates(max_states);
+  std::vector<rlfd::segment::KohlmorgenLemm::ChangePoint> changes;
+  for (int t = 0; t < ts.rows(); t++) {
+    if (!embedding.AddObservation(ts.row(t).transpose())) {
+      continue;
+    }
+    segmenter.AddObservation(embedding.GetVector(), changes);
+    for (auto change : changes) {
+      std::cout << change.time << " " << change.state << std::endl;
+    }
+    changes.clear();
+  }
+
+  segmenter.Flush(changes);
+  for (auto change : changes) {
+    std::cout << change.time << " " << change.state << std::endl;
+  }
 
-  rlfd::segment::CSegmentation<rlfd::stats::GaussianDensityEstimator> segmenter(kde, W, regularizer);
-  segmenter(embTs);
+  auto statistics = segmenter.GetStatistics();
+  std::cerr << "States: " << statistics.created << " created, " << statistics.pruned << " pruned, "
+            << statistics.evicted << " evicted, " << statistics.peak << " active at most, "
+            << statistics.mean << " on average" << std::endl;
 
   return 0;
 }
@@ -18,15 +18,17 @@
  * Boston, MA  02110-1301, USA.
  */
 #include <rlfd/utils/Matio.hh>
+#include <rlfd/utils/ImportExport.hh>
 #include <Eigen/Core>
 #include <iostream>
 #include <limits>
 
 int main(int argc, char** argv)
 {
-  if (argc != 2) {
+  if (argc != 2 && argc != 3) {
     std::cerr << "Convert a Matlab's .mat file to a tabular raw .dat file" << std::endl;
-    std::cerr << "Usage: mattodat [FILE]" << std::endl;
+    std::cerr << "Usage: mattodat [FILE] [OUTPUT]" << std::endl;
+    std::cerr << "Writes to STDOUT unless OUTPUT is given, in binary if it ends with .bin" << std::endl;
     return -1;
   }
   // Import 
@@ -36,8 +38,11 @@ int main(int argc, char** argv)
   mat.Read(out);
   mat.Close();
 
-  std::cout.precision(std::numeric_limits<double>::digits10);
-  std::cout << out << std::endl;
+  if (argc == 3) {
+    rlfd::utils::Export(argv[2], out);
+  } else {
+    rlfd::utils::Export(out);
+  }
 
   return 0;
 }
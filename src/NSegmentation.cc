@@ -19,6 +19,7 @@
  */
 #include <rlfd/utils/ImportExport.hh>
 #include <rlfd/segment/NSegmentation.hh>
+#include <rlfd/segment/ChangePoints.hh>
 
 #include <limits>
 #include <iostream>
@@ -30,8 +31,11 @@ void print_usage(void)
 {
   std::cout << "Usage: nsegmentation [OPTION]" << std::endl;
   std::cout << "Execute the N-Segmentation algorithm on the data passed through STDIN" << std::endl;
-  std::cout << "  -D, --distance-matrix  a file containing the pre-computed all-pairs distances" << std::endl;
+  std::cout << "  -D, --distance-matrix  a file containing the pre-computed all-pairs distances," << std::endl;
+  std::cout << "                         either as text or as a tiled store from gaussiankde --tiled" << std::endl;
   std::cout << "  -N, --number-segments  the maximal number of segments" << std::endl;
+  std::cout << "  -p, --change-points    follow the cost of each optimal path with the times at" << std::endl;
+  std::cout << "                         which it changes state" << std::endl;
   std::cout << "  -h, --help             display this help and exit" << std::endl;
   std::cout << "\n\nFrom:\nJ. Kohlmorgen, \"On Optimal Segmentation of Sequential Data\", in" << std::endl;
   std::cout << "Proceedings of the 13th International IEEE workshop on Neural Networks for" << std::endl;
@@ -51,19 +55,21 @@ int main(int argc, char** argv)
 
   std::string distance_file;
   unsigned N = 0;
+  int change_points_flag = 0;
 
   // Parse arguments
   static struct option long_options[] =
   {
     {"distance-matrix", required_argument, 0, 'D'},
     {"number-segments", required_argument, 0, 'N'},
+    {"change-points", no_argument, 0, 'p'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
 
   int option_index = 0;
   int c;
-  while ((c = getopt_long(argc, argv, "N:D:h", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "N:D:ph", long_options, &option_index)) != -1)
   {
     switch (c)
     {
@@ -73,6 +79,9 @@ int main(int argc, char** argv)
       case 'N':
         N = std::stoul(optarg);
         break;
+      case 'p':
+        change_points_flag = 1;
+        break;
       case '?':
       case 'h':
       default:
@@ -81,14 +90,39 @@ int main(int argc, char** argv)
     }
   }
 
-  // Read the distance matrix
-  Eigen::MatrixXd dists;
-  if (distance_file != "") {
-    rlfd::utils::Import(distance_file, dists);
+  // Compute the segmentation, reading the distances from a tiled store one
+  // panel at a time, or mapping binary distance matrices in place
+  Eigen::VectorXd costs;
+  Eigen::MatrixXi states;
+  if (distance_file != "" && rlfd::utils::DistanceStore::IsStore(distance_file)) {
+    rlfd::utils::DistanceStore store;
+    store.Open(distance_file);
+    rlfd::segment::NSegmentation(store, N, costs, states);
+  } else if (distance_file != "" && rlfd::utils::Binaryio<>::IsBinary(distance_file)) {
+    rlfd::utils::Binaryio<> binary;
+    binary.Open(distance_file);
+    rlfd::segment::NSegmentation(binary.Map(), N, costs, states);
+  } else {
+    Eigen::MatrixXd dists;
+    if (distance_file != "") {
+      rlfd::utils::Import(distance_file, dists);
+    }
+    rlfd::segment::NSegmentation(dists, N, costs, states);
   }
 
-  // Compute the segmentation
-  rlfd::segment::NSegmentation(dists, N);
+  // One line per number of segments, with the cost of the optimal path and
+  // optionally the times at which it changes state
+  for (unsigned n = 0; n < N; n++) {
+    std::cout << n+1 << "    " << costs[n];
+    if (change_points_flag && states(n, 0) >= 0) {
+      Eigen::VectorXi changes;
+      rlfd::segment::ChangePoints(states.row(n).transpose(), changes);
+      for (int i = 0; i < changes.size(); i++) {
+        std::cout << "    " << changes[i];
+      }
+    }
+    std::cout << std::endl;
+  }
 
   return 0;
 }
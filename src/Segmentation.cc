@@ -0,0 +1,253 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include <rlfd/utils/ImportExport.hh>
+#include <rlfd/segment/Pipeline.hh>
+#include <rlfd/segment/ChangePoints.hh>
+
+#include <limits>
+#include <iostream>
+
+#include <getopt.h>
+#include <Eigen/Core>
+
+void print_usage(void)
+{
+  std::cout << "Usage: segmentation [OPTION] [FILE]" << std::endl;
+  std::cout << "Delay embed a time series, estimate the densities over sliding windows and" << std::endl;
+  std::cout << "segment it with C-Segmentation or N-Segmentation, all in a single process. The" << std::endl;
+  std::cout << "columns of a multichannel series are segmented jointly." << std::endl;
+  std::cout << "  -m, --dimension        the embedding dimension, or a comma-separated one per channel" << std::endl;
+  std::cout << "  -d, --delay            the lag value, or a comma-separated one per channel" << std::endl;
+  std::cout << "  -w, --window           the window size in which the PDF should be estimated" << std::endl;
+  std::cout << "  -s, --sigma            the kernel bandwidth. Estimated from the data when omitted" << std::endl;
+  std::cout << "  -j, --threads          the number of threads used to compute the distances. 0 uses" << std::endl;
+  std::cout << "                         all cores" << std::endl;
+  std::cout << "  -b, --backend          how to compute the kernel sums: incremental (default), gemm," << std::endl;
+  std::cout << "                         truncated or pairwise" << std::endl;
+  std::cout << "  -k, --summation        how the pairwise backend sums the kernel terms of two windows:" << std::endl;
+  std::cout << "                         exact (default), ifgt or dualtree" << std::endl;
+  std::cout << "  -e, --tolerance        the error allowed in each distance by the truncated backend, and" << std::endl;
+  std::cout << "                         per kernel term by the ifgt and dualtree summations. Defaults to" << std::endl;
+  std::cout << "                         1e-12 and 1e-6, as for gaussiankde" << std::endl;
+  std::cout << "  -C, --regularizer      run C-Segmentation with this regularization constant" << std::endl;
+  std::cout << "  -N, --number-segments  run N-Segmentation up to this number of segments instead" << std::endl;
+  std::cout << "  -p, --change-points    print change points instead of the state at every time" << std::endl;
+  std::cout << "  -E, --embedding        also write the delay vectors to this file" << std::endl;
+  std::cout << "  -D, --distance-matrix  also write the distances to this file" << std::endl;
+  std::cout << "  -t, --tiled            hold the distances in this tiled store instead of memory" << std::endl;
+  std::cout << "  -h, --help             display this help and exit" << std::endl;
+  std::cout << "\nFiles ending with .bin are written in binary, others as tabular text. The output" << std::endl;
+  std::cout << "is the same as that of csegmentation or nsegmentation." << std::endl;
+  std::cout << "\n\nFrom:\nJ. Kohlmorgen, \"On Optimal Segmentation of Sequential Data\", in" << std::endl;
+  std::cout << "Proceedings of the 13th International IEEE workshop on Neural Networks for" << std::endl;
+  std::cout << "Signal Processing, 2003, pp. 449–458." << std::endl;
+  std::cout << "\nAuthor: Pierre-Luc Bacon <pbacon@mail.mcgill.ca>" << std::endl;
+  std::cout << "Report bugs to: https://github.com/pierrelux/rlfd_segmentation" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  std::cout.precision(std::numeric_limits<double>::digits10);
+
+  std::string embedding_dimension = "2";
+  std::string lag = "1";
+  int W = 50;
+  double sigma = 0.0;
+  unsigned threads = 1;
+  std::string backend = "incremental";
+  std::string summation = "exact";
+  double tolerance = 1e-12;
+  double term_tolerance = 1e-6;
+  double regularizer = 0.0;
+  unsigned N = 0;
+  int change_points_flag = 0;
+  std::string embedding_file;
+  std::string distance_file;
+  std::string tiled_file;
+
+  // Parse arguments
+  static struct option long_options[] =
+  {
+    {"dimension", required_argument, 0, 'm'},
+    {"delay", required_argument, 0, 'd'},
+    {"window", required_argument, 0, 'w'},
+    {"sigma", required_argument, 0, 's'},
+    {"threads", required_argument, 0, 'j'},
+    {"backend", required_argument, 0, 'b'},
+    {"summation", required_argument, 0, 'k'},
+    {"tolerance", required_argument, 0, 'e'},
+    {"regularizer", required_argument, 0, 'C'},
+    {"number-segments", required_argument, 0, 'N'},
+    {"change-points", no_argument, 0, 'p'},
+    {"embedding", required_argument, 0, 'E'},
+    {"distance-matrix", required_argument, 0, 'D'},
+    {"tiled", required_argument, 0, 't'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+  };
+
+  int option_index = 0;
+  int c;
+  while ((c = getopt_long(argc, argv, "m:d:w:s:j:b:k:e:C:N:pE:D:t:h", long_options, &option_index)) != -1)
+  {
+    switch (c)
+    {
+      case 'm':
+        embedding_dimension = std::string(optarg);
+        break;
+      case 'd':
+        lag = std::string(optarg);
+        break;
+      case 'w':
+        W = std::stoi(optarg);
+        break;
+      case 's':
+        sigma = std::stod(optarg);
+        break;
+      case 'j':
+        threads = std::stoul(optarg);
+        break;
+      case 'b':
+        backend = std::string(optarg);
+        break;
+      case 'k':
+        summation = std::string(optarg);
+        break;
+      case 'e':
+        tolerance = std::stod(optarg);
+        term_tolerance = tolerance;
+        break;
+      case 'C':
+        regularizer = std::stod(optarg);
+        break;
+      case 'N':
+        N = std::stoul(optarg);
+        break;
+      case 'p':
+        change_points_flag = 1;
+        break;
+      case 'E':
+        embedding_file = std::string(optarg);
+        break;
+      case 'D':
+        distance_file = std::string(optarg);
+        break;
+      case 't':
+        tiled_file = std::string(optarg);
+        break;
+      case '?':
+      case 'h':
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  // Read the time series
+  Eigen::MatrixXd ts;
+  if (optind < argc) {
+    rlfd::utils::Import(argv[optind], ts);
+  } else {
+    rlfd::utils::Import(ts);
+  }
+
+  Eigen::VectorXi m, lags;
+  try {
+    m = rlfd::delay::ChannelParameters(embedding_dimension, ts.cols());
+    lags = rlfd::delay::ChannelParameters(lag, ts.cols());
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    print_usage();
+    return -1;
+  }
+
+  rlfd::segment::Pipeline pipeline(m, lags, W);
+  pipeline.SetSigma(sigma);
+  pipeline.SetThreads(threads);
+  pipeline.SetEmbeddingSpill(embedding_file);
+  pipeline.SetDistanceSpill(distance_file);
+  pipeline.SetTiledStore(tiled_file);
+
+  if (backend == "gemm") {
+    pipeline.SetBackend(rlfd::stats::GaussianDensityEstimator::Backend::Gemm, tolerance);
+  } else if (backend == "truncated") {
+    pipeline.SetBackend(rlfd::stats::GaussianDensityEstimator::Backend::Truncated, tolerance);
+  } else if (backend == "pairwise") {
+    pipeline.SetBackend(rlfd::stats::GaussianDensityEstimator::Backend::Pairwise, tolerance);
+  } else if (backend == "incremental") {
+    pipeline.SetBackend(rlfd::stats::GaussianDensityEstimator::Backend::Incremental, tolerance);
+  } else {
+    std::cerr << "Unknown backend " << backend << std::endl;
+    print_usage();
+    return -1;
+  }
+
+  try {
+    pipeline.SetSummation(rlfd::stats::KernelSummation(rlfd::stats::KernelSummation::ParseMethod(summation), term_tolerance));
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    print_usage();
+    return -1;
+  }
+
+  std::cerr << "Computing distances..." << std::endl;
+  try {
+    pipeline.Run(ts);
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+  std::cerr << "Sigma: " << pipeline.GetBandwidth() << std::endl;
+
+  if (N > 0) {
+    Eigen::VectorXd costs;
+    Eigen::MatrixXi states;
+    pipeline.NSegment(N, costs, states);
+
+    for (unsigned n = 0; n < N; n++) {
+      std::cout << n+1 << "    " << costs[n];
+      if (change_points_flag && states(n, 0) >= 0) {
+        Eigen::VectorXi changes;
+        rlfd::segment::ChangePoints(states.row(n).transpose(), changes);
+        for (int i = 0; i < changes.size(); i++) {
+          std::cout << "    " << changes[i];
+        }
+      }
+      std::cout << std::endl;
+    }
+    return 0;
+  }
+
+  Eigen::VectorXi states;
+  double cost = pipeline.CSegment(regularizer, states);
+  std::cerr << "Cost of the optimal path: " << cost << std::endl;
+
+  if (change_points_flag) {
+    Eigen::VectorXi changes;
+    rlfd::segment::ChangePoints(states, changes);
+    for (int i = 0; i < changes.size(); i++) {
+      std::cout << changes[i] << " " << states[changes[i]] << std::endl;
+    }
+  } else {
+    std::cout << states << std::endl;
+  }
+
+  return 0;
+}
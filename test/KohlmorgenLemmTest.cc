@@ -0,0 +1,226 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include <rlfd/segment/KohlmorgenLemm.hh>
+#include <rlfd/stats/GaussianDensityEstimator.hh>
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <iostream>
+
+#include <Eigen/Core>
+
+typedef rlfd::segment::KohlmorgenLemm::ChangePoint ChangePoint;
+
+/**
+ * Exposes how much the segmenter holds
+ */
+class Probe : public rlfd::segment::KohlmorgenLemm
+{
+ public:
+  Probe(rlfd::stats::GaussianDensityEstimator& kde, int W, double C) : KohlmorgenLemm(kde, W, C) {};
+
+  size_t GetHistorySize() { return history_.rows(); }
+
+  size_t GetOptimaSize() { return optima_.size(); }
+
+  size_t GetWindowsSize() { return windows_.Size(); }
+};
+
+/**
+ * Segment a sequence with the dynamic program of the original batch
+ * implementation, on the full matrix of window distances, and backtrack its
+ * optimal path.
+ * @param D The symmetric distances between the N windows
+ * @param cost Receives the cost of the optimal path at the last window
+ */
+std::vector<ChangePoint> Reference(const Eigen::MatrixXd& D, double C, double& cost)
+{
+  const int N = D.rows();
+
+  // Where the path of a state at a time comes from: the same state, the start
+  // of the sequence, or the state that was optimal at the time before
+  const int Stay = -1;
+  const int Start = -2;
+  Eigen::MatrixXi from = Eigen::MatrixXi::Constant(N, N, Stay);
+
+  std::vector<double> costs(1, 0.0);
+  std::vector<double> optima(1, 0.0);
+  std::vector<int> optimal(1, 0);
+  from(0, 0) = Start;
+
+  for (int n = 1; n < N; n++) {
+    // C_t(n) for every past time t, lowering the optimal costs
+    double c = 0.0;
+    for (int t = 0; t < n; t++) {
+      if (t == 0) {
+        c = D(n, 0);
+        from(n, 0) = Start;
+      } else if (c <= optima[t-1] + C) {
+        c += D(n, t);
+      } else {
+        c = optima[t-1] + C + D(n, t);
+        from(n, t) = optimal[t-1];
+      }
+      if (c < optima[t]) {
+        optima[t] = c;
+        optimal[t] = n;
+      }
+    }
+    costs.push_back(c);
+
+    // C_n(s) for every state
+    for (int s = 0; s <= n; s++) {
+      if (costs[s] <= optima[n-1] + C) {
+        costs[s] += D(s, n);
+      } else {
+        costs[s] = optima[n-1] + C + D(s, n);
+        from(s, n) = optimal[n-1];
+      }
+    }
+    int best = std::min_element(costs.begin(), costs.end()) - costs.begin();
+    optima.push_back(costs[best]);
+    optimal.push_back(best);
+  }
+  cost = optima.back();
+
+  std::vector<ChangePoint> segments;
+  int state = optimal.back();
+  for (int t = N - 1; t >= 0; t--) {
+    if (from(state, t) == Stay) {
+      continue;
+    }
+    segments.insert(segments.begin(), ChangePoint{t, state});
+    if (from(state, t) == Start) {
+      break;
+    }
+    state = from(state, t);
+  }
+  return segments;
+}
+
+/**
+ * Segment a long series of random regimes with the default horizon, which must
+ * report changes before the end of the series and hold a bounded number of
+ * states, optimal costs, windows and samples.
+ */
+int CheckHorizon(rlfd::stats::GaussianDensityEstimator& kde, int W, double C)
+{
+  std::mt19937 generator(11);
+  std::normal_distribution<double> noise(0.0, 0.4);
+  std::uniform_int_distribution<int> length(80, 400);
+  std::uniform_real_distribution<double> level(-2.0, 2.0);
+  Eigen::MatrixXd ts(2000, 2);
+  double center = 0.0;
+  int left = 0;
+  for (int i = 0; i < ts.rows(); i++) {
+    if (left-- == 0) {
+      left = length(generator);
+      center = level(generator);
+    }
+    ts(i, 0) = center + noise(generator);
+    ts(i, 1) = -center + noise(generator);
+  }
+
+  Probe segmenter(kde, W, C);
+  const size_t H = segmenter.GetHorizon();
+  std::vector<ChangePoint> changes;
+  size_t history = 0;
+  int failures = 0;
+  for (int i = 0; i < ts.rows(); i++) {
+    segmenter.AddObservation(ts.row(i).transpose(), changes);
+    if (i == ts.rows()/2) {
+      history = segmenter.GetHistorySize();
+    }
+    if (segmenter.GetActiveStates() > H || segmenter.GetOptimaSize() > H + 1 ||
+        segmenter.GetWindowsSize() > H + 2) {
+      std::cerr << "C = " << C << ": more than the horizon is held at sample " << i << std::endl;
+      return 1;
+    }
+  }
+  if (segmenter.GetHistorySize() != history) {
+    std::cerr << "C = " << C << ": the history grows from " << history << " to "
+              << segmenter.GetHistorySize() << " samples" << std::endl;
+    failures++;
+  }
+
+  // The last regime can only be reported by Flush()
+  if (changes.size() < 2) {
+    std::cerr << "C = " << C << ": only " << changes.size() << " changes reported before the end" << std::endl;
+    failures++;
+  }
+  return failures;
+}
+
+int main(int argc, char** argv)
+{
+  // Three regimes of two-dimensional samples
+  const int W = 20;
+  std::mt19937 generator(7);
+  std::normal_distribution<double> noise(0.0, 0.4);
+  Eigen::MatrixXd ts(300, 2);
+  for (int i = 0; i < ts.rows(); i++) {
+    double center = (i < 110) ? 0.0 : ((i < 190) ? 1.5 : -1.0);
+    ts(i, 0) = center + noise(generator);
+    ts(i, 1) = -center + noise(generator);
+  }
+
+  rlfd::stats::GaussianDensityEstimator kde(0.5, 2);
+  const int N = ts.rows() - W;
+  Eigen::MatrixXd D = Eigen::MatrixXd::Zero(N, N);
+  kde.DistanceMatrix(ts, W, D);
+  D = D.selfadjointView<Eigen::Lower>();
+
+  int failures = 0;
+  for (double C : {0.05, 0.5, 5.0}) {
+    double cost;
+    std::vector<ChangePoint> expected = Reference(D, C, cost);
+
+    // The last window of the distance matrix ends one sample before the series
+    // Without a horizon, the segmenter is exact
+    rlfd::segment::KohlmorgenLemm segmenter(kde, W, C);
+    segmenter.SetHorizon(0);
+    std::vector<ChangePoint> changes;
+    for (int i = 0; i < N + W - 1; i++) {
+      segmenter.AddObservation(ts.row(i).transpose(), changes);
+    }
+    segmenter.Flush(changes);
+
+    bool same = changes.size() == expected.size();
+    for (size_t i = 0; same && i < changes.size(); i++) {
+      same = changes[i].time == expected[i].time && changes[i].state == expected[i].state;
+    }
+    if (!same || std::abs(segmenter.GetCost() - cost) > 1e-9*std::max(1.0, cost)) {
+      std::cerr << "C = " << C << ": the streaming segmentation differs from the reference" << std::endl;
+      for (auto change : expected) {
+        std::cerr << "  expected " << change.time << " " << change.state << std::endl;
+      }
+      for (auto change : changes) {
+        std::cerr << "  got      " << change.time << " " << change.state << std::endl;
+      }
+      std::cerr << "  cost " << segmenter.GetCost() << " instead of " << cost << std::endl;
+      failures++;
+    }
+
+    failures += CheckHorizon(kde, W, C);
+  }
+
+  return failures;
+}
@@ -0,0 +1,90 @@
+/**
+ * Skills segmentation and learning for Robot Learning by Demonstration
+ * Copyright (C) 2012  Pierre-Luc Bacon <pierre-luc.bacon@mail.mcgill.ca>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include <rlfd/stats/GaussianDensityEstimator.hh>
+#include <rlfd/stats/RandomFourierDensityEstimator.hh>
+
+#include <cmath>
+#include <random>
+#include <iostream>
+
+#include <Eigen/Core>
+
+/**
+ * Root mean squared error of the approximate distances below the diagonal,
+ * relative to the root mean square of the exact ones.
+ */
+double RelativeError(const Eigen::MatrixXd& exact, const Eigen::MatrixXd& approximate)
+{
+  Eigen::MatrixXd error = (approximate - exact).triangularView<Eigen::StrictlyLower>();
+  Eigen::MatrixXd reference = exact.triangularView<Eigen::StrictlyLower>();
+  return error.norm()/reference.norm();
+}
+
+int main(int argc, char** argv)
+{
+  // Two regimes of three-dimensional samples
+  const int W = 20;
+  std::mt19937 generator(11);
+  std::normal_distribution<double> noise(0.0, 0.5);
+  Eigen::MatrixXd ts(160, 3);
+  for (int i = 0; i < ts.rows(); i++) {
+    double center = (i < 80) ? 0.0 : 1.0;
+    for (int j = 0; j < ts.cols(); j++) {
+      ts(i, j) = center + noise(generator);
+    }
+  }
+
+  const double sigma = 0.6;
+  const int N = ts.rows() - W;
+  rlfd::stats::GaussianDensityEstimator kde(sigma, ts.cols());
+  Eigen::MatrixXd exact = Eigen::MatrixXd::Zero(N, N);
+  kde.DistanceMatrix(ts, W, exact);
+
+  // The error decreases as 1/sqrt(D), but mostly as an error on the scale of
+  // all the distances, which varies a lot from one seed to the other. Taken
+  // over several seeds, it should at least halve when D is multiplied by 16
+  const unsigned Seeds = 10;
+  int failures = 0;
+  double previous = 0.0;
+  for (int D : {16, 256, 4096}) {
+    double error = 0.0;
+    for (unsigned seed = 1; seed <= Seeds; seed++) {
+      rlfd::stats::RandomFourierDensityEstimator rff(sigma, ts.cols(), D, seed);
+      Eigen::MatrixXd approximate = Eigen::MatrixXd::Zero(N, N);
+      rff.DistanceMatrix(ts, W, approximate, 0);
+      error += std::pow(RelativeError(exact, approximate), 2.0)/Seeds;
+    }
+    error = std::sqrt(error);
+    std::cout << "D = " << D << ": relative error " << error << std::endl;
+
+    if (previous > 0.0 && error > previous/2.0) {
+      std::cerr << "The error does not shrink from " << previous << " as D grows to " << D << std::endl;
+      failures++;
+    }
+    previous = error;
+  }
+
+  if (previous > 0.05) {
+    std::cerr << "The error with 4096 features is above 5%" << std::endl;
+    failures++;
+  }
+
+  return failures;
+}